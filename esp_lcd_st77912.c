@@ -1,16 +1,25 @@
+#include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/cdefs.h>
+#include <sys/param.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "driver/gpio.h"
+#include "driver/spi_master.h"
 #include "esp_check.h"
+#include "esp_heap_caps.h"
 #include "esp_lcd_panel_interface.h"
 #include "esp_lcd_panel_io.h"
 #include "esp_lcd_panel_vendor.h"
 #include "esp_lcd_panel_ops.h"
 #include "esp_lcd_panel_commands.h"
 #include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "nvs.h"
 
 #include "esp_lcd_st77912.h"
 
@@ -21,6 +30,20 @@
 #define ST77912_CMD_SET             (0xF0)
 #define ST77912_PARAM_SET           (0x00)
 
+#define ST77912_CALIB_WIN_W         (16)
+#define ST77912_CALIB_WIN_H         (4)
+#define ST77912_CALIB_PATTERNS      (3)
+#define ST77912_CALIB_NVS_KEY       "pclk_hz"
+
+#define ST77912_TX_RETRIES_DEFAULT  (2)
+#define ST77912_SLPOUT_FAST_MS      (5)
+
+// RDDST is read as 40 bits: one dummy clock, D31..D0, then padding
+#define ST77912_RDDST_MADCTL_SHIFT  (23)
+#define ST77912_RDDST_MADCTL_MASK   (0xFC)
+#define ST77912_RDDST_SLOUT         BIT(17)
+#define ST77912_RDDST_DISON         BIT(10)
+
 static const char *TAG = "st77912";
 
 static esp_err_t panel_st77912_del(esp_lcd_panel_t *panel);
@@ -33,6 +56,13 @@ static esp_err_t panel_st77912_swap_xy(esp_lcd_panel_t *panel, bool swap_axes);
 static esp_err_t panel_st77912_set_gap(esp_lcd_panel_t *panel, int x_gap, int y_gap);
 static esp_err_t panel_st77912_disp_on_off(esp_lcd_panel_t *panel, bool off);
 
+typedef struct {
+    int x_start;
+    int y_start;
+    int x_end;
+    int y_end;
+} st77912_area_t;
+
 typedef struct {
     esp_lcd_panel_t base;
     esp_lcd_panel_io_handle_t io;
@@ -44,9 +74,24 @@ typedef struct {
     uint8_t colmod_val;
     const st77912_lcd_init_cmd_t *init_cmds;
     uint16_t init_cmds_size;
+    uint8_t max_tx_retries;
+    st77912_recover_cb_t on_recover;
+    void *recover_ctx;
+    st77912_area_t drawn_area;
+    st77912_area_t lost_area;
+    st77912_fault_stats_t fault_stats;
+    st77912_trace_rec_t *trace_buf;
+    uint32_t trace_cap;
+    uint32_t trace_total;
+    st77912_panel_hooks_t hooks;
     struct {
         unsigned int use_qspi_interface: 1;
         unsigned int reset_level: 1;
+        unsigned int initialized: 1;
+        unsigned int display_on: 1;
+        unsigned int invert_set: 1;
+        unsigned int invert_color: 1;
+        unsigned int tracing: 1;
     } flags;
 } st77912_panel_t;
 
@@ -97,6 +142,7 @@ esp_err_t esp_lcd_new_panel_st77912(const esp_lcd_panel_io_handle_t io, const es
     st77912->io = io;
     st77912->reset_gpio_num = panel_dev_config->reset_gpio_num;
     st77912->flags.reset_level = panel_dev_config->flags.reset_active_high;
+    st77912->max_tx_retries = ST77912_TX_RETRIES_DEFAULT;
     st77912_vendor_config_t *vendor_config = (st77912_vendor_config_t *)panel_dev_config->vendor_config;
     if (vendor_config) {
         st77912->init_cmds = vendor_config->init_cmds;
@@ -129,24 +175,80 @@ err:
     return ret;
 }
 
+static void trace_rec(st77912_panel_t *st77912, uint8_t type, uint8_t cmd, uint16_t len, const void *data, size_t data_len)
+{
+    if (!st77912->flags.tracing) {
+        return;
+    }
+    st77912_trace_rec_t *rec = &st77912->trace_buf[st77912->trace_total % st77912->trace_cap];
+    rec->timestamp_us = (uint32_t)esp_timer_get_time();
+    rec->type = type;
+    rec->cmd = cmd;
+    rec->len = len;
+    memset(rec->data, 0, sizeof(rec->data));
+    if (data) {
+        memcpy(rec->data, data, MIN(data_len, sizeof(rec->data)));
+    }
+    st77912->trace_total++;
+}
+
 static esp_err_t tx_param(st77912_panel_t *st77912, esp_lcd_panel_io_handle_t io, int lcd_cmd, const void *param, size_t param_size)
 {
+    trace_rec(st77912, ST77912_TRACE_PARAM, lcd_cmd, param_size, param, param_size);
     if (st77912->flags.use_qspi_interface) {
         lcd_cmd &= 0xff;
         lcd_cmd <<= 8;
         lcd_cmd |= LCD_OPCODE_WRITE_CMD << 24;
     }
-    return esp_lcd_panel_io_tx_param(io, lcd_cmd, param, param_size);
+    esp_err_t ret = esp_lcd_panel_io_tx_param(io, lcd_cmd, param, param_size);
+    if (ret != ESP_OK) {
+        st77912->fault_stats.tx_errors++;
+    }
+    return ret;
 }
 
 static esp_err_t tx_color(st77912_panel_t *st77912, esp_lcd_panel_io_handle_t io, int lcd_cmd, const void *param, size_t param_size)
 {
+    trace_rec(st77912, ST77912_TRACE_COLOR, lcd_cmd, 0, &(uint32_t) {
+        param_size
+    }, sizeof(uint32_t));
     if (st77912->flags.use_qspi_interface) {
         lcd_cmd &= 0xff;
         lcd_cmd <<= 8;
         lcd_cmd |= LCD_OPCODE_WRITE_COLOR << 24;
     }
-    return esp_lcd_panel_io_tx_color(io, lcd_cmd, param, param_size);
+    esp_err_t ret = esp_lcd_panel_io_tx_color(io, lcd_cmd, param, param_size);
+    if (ret != ESP_OK) {
+        st77912->fault_stats.tx_errors++;
+    }
+    return ret;
+}
+
+static esp_err_t rx_param(st77912_panel_t *st77912, esp_lcd_panel_io_handle_t io, int lcd_cmd, void *param, size_t param_size)
+{
+    trace_rec(st77912, ST77912_TRACE_READ, lcd_cmd, param_size, NULL, 0);
+    if (st77912->flags.use_qspi_interface) {
+        lcd_cmd &= 0xff;
+        lcd_cmd <<= 8;
+        lcd_cmd |= LCD_OPCODE_READ_CMD << 24;
+    }
+    esp_err_t ret = esp_lcd_panel_io_rx_param(io, lcd_cmd, param, param_size);
+    if (ret != ESP_OK) {
+        st77912->fault_stats.rx_errors++;
+    }
+    return ret;
+}
+
+static void area_merge(st77912_area_t *area, int x_start, int y_start, int x_end, int y_end)
+{
+    if (area->x_start >= area->x_end) {
+        *area = (st77912_area_t) {x_start, y_start, x_end, y_end};
+        return;
+    }
+    area->x_start = MIN(area->x_start, x_start);
+    area->y_start = MIN(area->y_start, y_start);
+    area->x_end = MAX(area->x_end, x_end);
+    area->y_end = MAX(area->y_end, y_end);
 }
 
 static esp_err_t panel_st77912_del(esp_lcd_panel_t *panel)
@@ -166,6 +268,7 @@ static esp_err_t panel_st77912_reset(esp_lcd_panel_t *panel)
     st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
     esp_lcd_panel_io_handle_t io = st77912->io;
 
+    trace_rec(st77912, ST77912_TRACE_RESET, st77912->reset_gpio_num >= 0, 0, NULL, 0);
     if (st77912->reset_gpio_num >= 0) {
         gpio_set_level(st77912->reset_gpio_num, st77912->flags.reset_level);
         vTaskDelay(pdMS_TO_TICKS(10));
@@ -273,22 +376,15 @@ static const st77912_lcd_init_cmd_t vendor_specific_init_default[] = {
     {0x11, (uint8_t []){0x00}, 1, 120},
 };
 
-static esp_err_t panel_st77912_init(esp_lcd_panel_t *panel)
+static esp_err_t send_init_cmds(st77912_panel_t *st77912, bool fast)
 {
-    st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
     esp_lcd_panel_io_handle_t io = st77912->io;
     const st77912_lcd_init_cmd_t *init_cmds = NULL;
     uint16_t init_cmds_size = 0;
     bool is_user_set = true;
     bool is_cmd_overwritten = false;
 
-    ESP_RETURN_ON_ERROR(tx_param(st77912, io, LCD_CMD_MADCTL, (uint8_t[]) {
-        st77912->madctl_val,
-    }, 1), TAG, "send command failed");
-    ESP_RETURN_ON_ERROR(tx_param(st77912, io, LCD_CMD_COLMOD, (uint8_t[]) {
-        st77912->colmod_val,
-    }, 1), TAG, "send command failed");
-
+    trace_rec(st77912, ST77912_TRACE_INIT, fast, 0, NULL, 0);
     if (st77912->init_cmds) {
         init_cmds = st77912->init_cmds;
         init_cmds_size = st77912->init_cmds_size;
@@ -319,22 +415,56 @@ static esp_err_t panel_st77912_init(esp_lcd_panel_t *panel)
             }
         }
 
+        unsigned int delay_ms = init_cmds[i].delay_ms;
+        if (fast) {
+            // the controller has already reset itself, and only needs 5 ms after SLPOUT before the next command
+            if (init_cmds[i].cmd == LCD_CMD_SWRESET && init_cmds[i].data_bytes == 0) {
+                continue;
+            }
+            if (init_cmds[i].cmd == LCD_CMD_SLPOUT) {
+                delay_ms = MIN(delay_ms, ST77912_SLPOUT_FAST_MS);
+            }
+        }
+
         ESP_RETURN_ON_ERROR(tx_param(st77912, io, init_cmds[i].cmd, init_cmds[i].data, init_cmds[i].data_bytes), TAG, "send command failed");
-        vTaskDelay(pdMS_TO_TICKS(init_cmds[i].delay_ms));
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
 
         if ((init_cmds[i].cmd == ST77912_CMD_SET)) {
             is_user_set = ((uint8_t *)init_cmds[i].data)[0] == ST77912_PARAM_SET ? true : false;
         }
     }
+    // after the table, which starts with SWRESET and would reset them to their defaults again
+    ESP_RETURN_ON_ERROR(tx_param(st77912, io, LCD_CMD_MADCTL, (uint8_t[]) {
+        st77912->madctl_val,
+    }, 1), TAG, "send command failed");
+    ESP_RETURN_ON_ERROR(tx_param(st77912, io, LCD_CMD_COLMOD, (uint8_t[]) {
+        st77912->colmod_val,
+    }, 1), TAG, "send command failed");
     ESP_LOGD(TAG, "send init commands success");
+    if (st77912->hooks.on_init) {
+        st77912->hooks.on_init(&st77912->base, st77912->hooks.user_ctx);
+    }
 
     return ESP_OK;
 }
 
-static esp_err_t panel_st77912_draw_bitmap(esp_lcd_panel_t *panel, int x_start, int y_start, int x_end, int y_end, const void *color_data)
+static esp_err_t panel_st77912_init(esp_lcd_panel_t *panel)
 {
     st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
-    assert((x_start < x_end) && (y_start < y_end) && "start position must be smaller than end position");
+
+    st77912->flags.initialized = 0;
+    ESP_RETURN_ON_ERROR(send_init_cmds(st77912, false), TAG, "send init commands failed");
+    st77912->drawn_area = (st77912_area_t) {0};
+    st77912->lost_area = (st77912_area_t) {0};
+    st77912->flags.display_on = 0;
+    st77912->flags.invert_set = 0;
+    st77912->flags.initialized = 1;
+
+    return ESP_OK;
+}
+
+static esp_err_t set_window(st77912_panel_t *st77912, int x_start, int y_start, int x_end, int y_end)
+{
     esp_lcd_panel_io_handle_t io = st77912->io;
 
     x_start += st77912->x_gap;
@@ -354,9 +484,55 @@ static esp_err_t panel_st77912_draw_bitmap(esp_lcd_panel_t *panel, int x_start,
         ((y_end - 1) >> 8) & 0xFF,
         (y_end - 1) & 0xFF,
     }, 4), TAG, "send command failed");
+
+    return ESP_OK;
+}
+
+static esp_err_t tx_window(st77912_panel_t *st77912, int x_start, int y_start, int x_end, int y_end, const void *color_data)
+{
+    ESP_RETURN_ON_ERROR(set_window(st77912, x_start, y_start, x_end, y_end), TAG, "set window failed");
     size_t len = (x_end - x_start) * (y_end - y_start) * st77912->fb_bits_per_pixel / 8;
-    tx_color(st77912, io, LCD_CMD_RAMWR, color_data, len);
-    
+    ESP_RETURN_ON_ERROR(tx_color(st77912, st77912->io, LCD_CMD_RAMWR, color_data, len), TAG, "send color failed");
+
+    return ESP_OK;
+}
+
+// bookkeeping after pixels went out, drawn by draw_bitmap or around it (esp_lcd_st77912_notify_draw)
+static void draw_done(st77912_panel_t *st77912, int x_start, int y_start, int x_end, int y_end)
+{
+    area_merge(&st77912->drawn_area, x_start, y_start, x_end, y_end);
+    if (st77912->hooks.on_draw) {
+        st77912->hooks.on_draw(&st77912->base, x_start, y_start, x_end, y_end,
+                               (x_end - x_start) * (y_end - y_start) * st77912->fb_bits_per_pixel / 8, st77912->hooks.user_ctx);
+    }
+}
+
+static esp_err_t panel_st77912_draw_bitmap(esp_lcd_panel_t *panel, int x_start, int y_start, int x_end, int y_end, const void *color_data)
+{
+    st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
+    assert((x_start < x_end) && (y_start < y_end) && "start position must be smaller than end position");
+    esp_err_t ret = ESP_OK;
+
+    trace_rec(st77912, ST77912_TRACE_DRAW, 0, 0, (int16_t[]) {
+        x_start, y_start, x_end, y_end
+    }, 4 * sizeof(int16_t));
+    for (int attempt = 0; attempt <= st77912->max_tx_retries; attempt++) {
+        if (attempt) {
+            st77912->fault_stats.tx_retries++;
+        }
+        ret = tx_window(st77912, x_start, y_start, x_end, y_end, color_data);
+        if (ret == ESP_OK) {
+            break;
+        }
+    }
+    if (ret != ESP_OK) {
+        st77912->fault_stats.tx_failures++;
+        area_merge(&st77912->lost_area, x_start, y_start, x_end, y_end);
+        ESP_LOGE(TAG, "draw bitmap failed after %d retries", st77912->max_tx_retries);
+        return ret;
+    }
+    draw_done(st77912, x_start, y_start, x_end, y_end);
+
     return ESP_OK;
 }
 
@@ -365,12 +541,17 @@ static esp_err_t panel_st77912_invert_color(esp_lcd_panel_t *panel, bool invert_
     st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
     esp_lcd_panel_io_handle_t io = st77912->io;
     int command = 0;
+    trace_rec(st77912, ST77912_TRACE_CALL, ST77912_TRACE_CALL_INVERT, 0, (uint8_t[]) {
+        invert_color_data
+    }, 1);
     if (invert_color_data) {
         command = LCD_CMD_INVON;
     } else {
         command = LCD_CMD_INVOFF;
     }
     ESP_RETURN_ON_ERROR(tx_param(st77912, io, command, NULL, 0), TAG, "send command failed");
+    st77912->flags.invert_set = 1;
+    st77912->flags.invert_color = invert_color_data;
     return ESP_OK;
 }
 
@@ -380,6 +561,9 @@ static esp_err_t panel_st77912_mirror(esp_lcd_panel_t *panel, bool mirror_x, boo
     esp_lcd_panel_io_handle_t io = st77912->io;
     esp_err_t ret = ESP_OK;
 
+    trace_rec(st77912, ST77912_TRACE_CALL, ST77912_TRACE_CALL_MIRROR, 0, (uint8_t[]) {
+        mirror_x, mirror_y
+    }, 2);
     if (mirror_x) {
         st77912->madctl_val |= BIT(6);
     } else {
@@ -400,6 +584,9 @@ static esp_err_t panel_st77912_swap_xy(esp_lcd_panel_t *panel, bool swap_axes)
 {
     st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
     esp_lcd_panel_io_handle_t io = st77912->io;
+    trace_rec(st77912, ST77912_TRACE_CALL, ST77912_TRACE_CALL_SWAP_XY, 0, (uint8_t[]) {
+        swap_axes
+    }, 1);
     if (swap_axes) {
         st77912->madctl_val |= LCD_CMD_MV_BIT;
     } else {
@@ -416,6 +603,9 @@ static esp_err_t panel_st77912_set_gap(esp_lcd_panel_t *panel, int x_gap, int y_
     st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
     st77912->x_gap = x_gap;
     st77912->y_gap = y_gap;
+    trace_rec(st77912, ST77912_TRACE_GAP, 0, 0, (int16_t[]) {
+        x_gap, y_gap
+    }, 2 * sizeof(int16_t));
     return ESP_OK;
 }
 
@@ -425,11 +615,398 @@ static esp_err_t panel_st77912_disp_on_off(esp_lcd_panel_t *panel, bool on_off)
     esp_lcd_panel_io_handle_t io = st77912->io;
     int command = 0;
 
+    trace_rec(st77912, ST77912_TRACE_CALL, ST77912_TRACE_CALL_DISP_ON_OFF, 0, (uint8_t[]) {
+        on_off
+    }, 1);
     if (on_off) {
         command = LCD_CMD_DISPON;
     } else {
         command = LCD_CMD_DISPOFF;
     }
     ESP_RETURN_ON_ERROR(tx_param(st77912, io, command, NULL, 0), TAG, "send command failed");
+    st77912->flags.display_on = on_off;
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_set_recovery(esp_lcd_panel_handle_t panel, const st77912_recovery_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(panel && config, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
+
+    st77912->max_tx_retries = config->max_tx_retries;
+    st77912->on_recover = config->on_recover;
+    st77912->recover_ctx = config->user_ctx;
+    return ESP_OK;
+}
+
+static esp_err_t read_status(st77912_panel_t *st77912, uint32_t *ret_status)
+{
+    uint8_t buf[5] = {0};
+    uint64_t raw = 0;
+
+    ESP_RETURN_ON_ERROR(rx_param(st77912, st77912->io, LCD_CMD_RDDST, buf, sizeof(buf)), TAG, "read status failed");
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        raw = (raw << 8) | buf[i];
+    }
+    *ret_status = (raw >> 7) & 0xFFFFFFFF;
+    return ESP_OK;
+}
+
+static esp_err_t fast_reinit(st77912_panel_t *st77912)
+{
+    esp_lcd_panel_io_handle_t io = st77912->io;
+    uint8_t madctl_val = st77912->madctl_val;
+
+    ESP_RETURN_ON_ERROR(send_init_cmds(st77912, true), TAG, "send init commands failed");
+    // the init sequence may carry its own MADCTL, restore what mirror()/swap_xy() left behind
+    st77912->madctl_val = madctl_val;
+    ESP_RETURN_ON_ERROR(tx_param(st77912, io, LCD_CMD_MADCTL, (uint8_t[]) {
+        st77912->madctl_val
+    }, 1), TAG, "send command failed");
+    if (st77912->flags.invert_set) {
+        ESP_RETURN_ON_ERROR(tx_param(st77912, io, st77912->flags.invert_color ? LCD_CMD_INVON : LCD_CMD_INVOFF, NULL, 0),
+                            TAG, "send command failed");
+    }
+    if (st77912->flags.display_on) {
+        ESP_RETURN_ON_ERROR(tx_param(st77912, io, LCD_CMD_DISPON, NULL, 0), TAG, "send command failed");
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_check_health(esp_lcd_panel_handle_t panel)
+{
+    ESP_RETURN_ON_FALSE(panel, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
+    ESP_RETURN_ON_FALSE(st77912->flags.initialized, ESP_ERR_INVALID_STATE, TAG, "panel not initialized");
+
+    trace_rec(st77912, ST77912_TRACE_CALL, ST77912_TRACE_CALL_CHECK_HEALTH, 0, NULL, 0);
+    uint32_t status = 0;
+    ESP_RETURN_ON_ERROR(read_status(st77912, &status), TAG, "read status failed");
+    uint8_t madctl = (status >> ST77912_RDDST_MADCTL_SHIFT) & ST77912_RDDST_MADCTL_MASK;
+    bool panel_reset = !(status & ST77912_RDDST_SLOUT) ||
+                       madctl != (st77912->madctl_val & ST77912_RDDST_MADCTL_MASK) ||
+                       (st77912->flags.display_on && !(status & ST77912_RDDST_DISON));
+
+    st77912_area_t replay = st77912->lost_area;
+    if (panel_reset) {
+        st77912->fault_stats.panel_resets++;
+        ESP_LOGW(TAG, "panel reset detected (status %08"PRIX32"), re-initializing", status);
+        ESP_RETURN_ON_ERROR(fast_reinit(st77912), TAG, "fast re-init failed");
+        st77912->fault_stats.recoveries++;
+        if (st77912->drawn_area.x_start < st77912->drawn_area.x_end) {
+            area_merge(&replay, st77912->drawn_area.x_start, st77912->drawn_area.y_start,
+                       st77912->drawn_area.x_end, st77912->drawn_area.y_end);
+        }
+    }
+
+    st77912->lost_area = (st77912_area_t) {0};
+    if (replay.x_start < replay.x_end && st77912->on_recover) {
+        st77912->on_recover(panel, replay.x_start, replay.y_start, replay.x_end, replay.y_end, st77912->recover_ctx);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_get_fault_stats(esp_lcd_panel_handle_t panel, st77912_fault_stats_t *ret_stats)
+{
+    ESP_RETURN_ON_FALSE(panel && ret_stats, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
+
+    *ret_stats = st77912->fault_stats;
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_set_hooks(esp_lcd_panel_handle_t panel, const st77912_panel_hooks_t *hooks)
+{
+    ESP_RETURN_ON_FALSE(panel, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
+
+    if (hooks) {
+        // another user's hooks would silently stop firing
+        ESP_RETURN_ON_FALSE(!st77912->hooks.on_draw && !st77912->hooks.on_init, ESP_ERR_INVALID_STATE, TAG, "hooks already set");
+        st77912->hooks = *hooks;
+    } else {
+        st77912->hooks = (st77912_panel_hooks_t) {0};
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_notify_draw(esp_lcd_panel_handle_t panel, int x_start, int y_start, int x_end, int y_end)
+{
+    ESP_RETURN_ON_FALSE(panel && x_start < x_end && y_start < y_end, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
+
+    draw_done(st77912, x_start, y_start, x_end, y_end);
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_get_hooks(esp_lcd_panel_handle_t panel, st77912_panel_hooks_t *ret_hooks)
+{
+    ESP_RETURN_ON_FALSE(panel && ret_hooks, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
+
+    *ret_hooks = st77912->hooks;
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_send_cmds(esp_lcd_panel_handle_t panel, const st77912_lcd_init_cmd_t *cmds, uint16_t cmds_size)
+{
+    ESP_RETURN_ON_FALSE(panel && (cmds || !cmds_size), ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
+
+    trace_rec(st77912, ST77912_TRACE_CALL, ST77912_TRACE_CALL_SEND_CMDS, cmds_size, NULL, 0);
+    for (int i = 0; i < cmds_size; i++) {
+        ESP_RETURN_ON_ERROR(tx_param(st77912, st77912->io, cmds[i].cmd, cmds[i].data, cmds[i].data_bytes), TAG, "send command failed");
+        vTaskDelay(pdMS_TO_TICKS(cmds[i].delay_ms));
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_trace_start(esp_lcd_panel_handle_t panel, void *buf, size_t size)
+{
+    ESP_RETURN_ON_FALSE(panel && buf && size >= sizeof(st77912_trace_rec_t), ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
+
+    st77912->trace_cap = size / sizeof(st77912_trace_rec_t);
+    st77912->trace_total = 0;
+    st77912->trace_buf = buf;
+    st77912->flags.tracing = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_trace_stop(esp_lcd_panel_handle_t panel)
+{
+    ESP_RETURN_ON_FALSE(panel, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
+
+    // keep the buffer so the trace can still be read out
+    st77912->flags.tracing = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_trace_get(esp_lcd_panel_handle_t panel, st77912_trace_rec_t *recs, size_t max_recs, size_t *ret_num, uint32_t *ret_dropped)
+{
+    ESP_RETURN_ON_FALSE(panel && recs && ret_num, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
+    ESP_RETURN_ON_FALSE(st77912->trace_buf, ESP_ERR_INVALID_STATE, TAG, "trace not started");
+
+    uint32_t num = MIN(st77912->trace_total, st77912->trace_cap);
+    uint32_t first = st77912->trace_total - num;
+    num = MIN(num, max_recs);
+    for (uint32_t i = 0; i < num; i++) {
+        recs[i] = st77912->trace_buf[(first + i) % st77912->trace_cap];
+    }
+    *ret_num = num;
+    if (ret_dropped) {
+        *ret_dropped = first;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_trace_dump(esp_lcd_panel_handle_t panel)
+{
+    ESP_RETURN_ON_FALSE(panel, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    st77912_panel_t *st77912 = __containerof(panel, st77912_panel_t, base);
+    ESP_RETURN_ON_FALSE(st77912->trace_buf, ESP_ERR_INVALID_STATE, TAG, "trace not started");
+
+    uint32_t num = MIN(st77912->trace_total, st77912->trace_cap);
+    uint32_t first = st77912->trace_total - num;
+    // one header line, then one line of hex per record, so the tool can pick them out of a noisy serial log
+    // the device config is there for the host replay, which has to build the same panel
+    // bpp as configured (18 for RGB666), not the 24 bits each pixel takes in the frame buffer
+    printf("ST77912TRACE v2 bpp=%d qspi=%d bgr=%d hwreset=%d recs=%"PRIu32" dropped=%"PRIu32"\n", st77912->fb_bits_per_pixel == 24 ? 18 : 16,
+           st77912->flags.use_qspi_interface, !!(st77912->madctl_val & LCD_CMD_BGR_BIT), st77912->reset_gpio_num >= 0, num, first);
+    for (uint32_t i = 0; i < num; i++) {
+        const uint8_t *rec = (const uint8_t *)&st77912->trace_buf[(first + i) % st77912->trace_cap];
+        printf("ST77912TRACE ");
+        for (size_t j = 0; j < sizeof(st77912_trace_rec_t); j++) {
+            printf("%02x", rec[j]);
+        }
+        printf("\n");
+    }
+    printf("ST77912TRACE end\n");
+    return ESP_OK;
+}
+
+static void calib_fill_pattern(uint8_t *buf, size_t len, uint32_t seed)
+{
+    // xorshift32, so every pattern toggles plenty of data lines without a table in flash
+    uint32_t x = seed;
+    for (size_t i = 0; i < len; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = x & 0xFF;
+    }
+}
+
+static esp_err_t calib_write(st77912_panel_t *st77912, uint8_t *const patterns[], int shift)
+{
+    // one window per pattern, stacked, and rotated every round so a write that never arrives can't pass on stale GRAM
+    for (int i = 0; i < ST77912_CALIB_PATTERNS; i++) {
+        ESP_RETURN_ON_ERROR(panel_st77912_draw_bitmap(&st77912->base, 0, i * ST77912_CALIB_WIN_H, ST77912_CALIB_WIN_W, (i + 1) * ST77912_CALIB_WIN_H,
+                                                      patterns[(i + shift) % ST77912_CALIB_PATTERNS]), TAG, "write pattern failed");
+    }
+    return ESP_OK;
+}
+
+static esp_err_t calib_read(st77912_panel_t *st77912, uint8_t *rx_buf, size_t rx_len, uint32_t crcs[])
+{
+    // RAMRD returns pixels in the controller's read-back format (dummy cycle, RGB666 even in RGB565 mode),
+    // comparing CRCs against the reference readback avoids decoding it
+    for (int i = 0; i < ST77912_CALIB_PATTERNS; i++) {
+        ESP_RETURN_ON_ERROR(set_window(st77912, 0, i * ST77912_CALIB_WIN_H, ST77912_CALIB_WIN_W, (i + 1) * ST77912_CALIB_WIN_H),
+                            TAG, "set window failed");
+        memset(rx_buf, 0, rx_len);
+        ESP_RETURN_ON_ERROR(rx_param(st77912, st77912->io, LCD_CMD_RAMRD, rx_buf, rx_len), TAG, "read GRAM failed");
+        crcs[i] = esp_rom_crc32_le(0, rx_buf, rx_len);
+    }
+    return ESP_OK;
+}
+
+// pclk_hz is fixed when the panel IO is created, so swap in a new one under the same panel
+static esp_err_t calib_set_pclk(st77912_panel_t *st77912, esp_lcd_spi_bus_handle_t bus, esp_lcd_panel_io_spi_config_t *io_config, uint32_t pclk_hz)
+{
+    if (st77912->io) {
+        ESP_RETURN_ON_ERROR(esp_lcd_panel_io_del(st77912->io), TAG, "delete panel IO failed");
+        st77912->io = NULL;
+    }
+    io_config->pclk_hz = pclk_hz;
+    ESP_RETURN_ON_ERROR(esp_lcd_new_panel_io_spi(bus, io_config, &st77912->io), TAG, "create panel IO failed");
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_calibrate_pclk(esp_lcd_spi_bus_handle_t bus, const esp_lcd_panel_io_spi_config_t *io_config, const esp_lcd_panel_dev_config_t *panel_dev_config,
+                                         const st77912_pclk_calib_config_t *calib_config, uint32_t *ret_pclk_hz)
+{
+    ESP_RETURN_ON_FALSE(io_config && panel_dev_config && calib_config && ret_pclk_hz, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(calib_config->start_pclk_hz && calib_config->src_clk_hz >= calib_config->start_pclk_hz && calib_config->rounds &&
+                        calib_config->start_pclk_hz <= calib_config->max_pclk_hz && calib_config->margin_percent < 100,
+                        ESP_ERR_INVALID_ARG, TAG, "invalid calibration config");
+
+    esp_err_t ret = ESP_OK;
+    esp_lcd_panel_io_handle_t io = NULL;
+    esp_lcd_panel_handle_t panel = NULL;
+    st77912_panel_t *st77912 = NULL;
+    uint8_t *patterns[ST77912_CALIB_PATTERNS] = {NULL};
+    uint8_t *rx_buf = NULL;
+    uint32_t ref_crcs[ST77912_CALIB_PATTERNS] = {0};
+    uint32_t crcs[ST77912_CALIB_PATTERNS] = {0};
+    esp_lcd_panel_io_spi_config_t calib_io_config = *io_config;
+    calib_io_config.on_color_trans_done = NULL;
+    calib_io_config.user_ctx = NULL;
+    // the bus can only run at src_clk_hz / n, so only those clocks are worth probing
+    uint32_t src_hz = calib_config->src_clk_hz;
+    uint32_t start_hz = spi_get_actual_clock(src_hz, calib_config->start_pclk_hz, 128);
+    calib_io_config.pclk_hz = start_hz;
+
+    size_t pattern_len = ST77912_CALIB_WIN_W * ST77912_CALIB_WIN_H * 3;
+    size_t rx_len = pattern_len + 1;
+    for (int i = 0; i < ST77912_CALIB_PATTERNS; i++) {
+        patterns[i] = heap_caps_malloc(pattern_len, MALLOC_CAP_DMA);
+        ESP_GOTO_ON_FALSE(patterns[i], ESP_ERR_NO_MEM, err, TAG, "no mem for calibration pattern");
+        calib_fill_pattern(patterns[i], pattern_len, 0x9E3779B9u * (i + 1));
+    }
+    rx_buf = heap_caps_malloc(rx_len, MALLOC_CAP_DMA);
+    ESP_GOTO_ON_FALSE(rx_buf, ESP_ERR_NO_MEM, err, TAG, "no mem for calibration readback");
+
+    ESP_GOTO_ON_ERROR(esp_lcd_new_panel_io_spi(bus, &calib_io_config, &io), err, TAG, "create panel IO failed");
+    ESP_GOTO_ON_ERROR(esp_lcd_new_panel_st77912(io, panel_dev_config, &panel), err, TAG, "create panel failed");
+    // the panel owns the IO from here on, calib_set_pclk() replaces it
+    st77912 = __containerof(panel, st77912_panel_t, base);
+    io = NULL;
+    ESP_GOTO_ON_ERROR(panel_st77912_reset(panel), err, TAG, "reset panel failed");
+    ESP_GOTO_ON_ERROR(panel_st77912_init(panel), err, TAG, "init panel failed");
+
+    ESP_GOTO_ON_ERROR(calib_write(st77912, patterns, 0), err, TAG, "reference write failed");
+    ESP_GOTO_ON_ERROR(calib_read(st77912, rx_buf, rx_len, ref_crcs), err, TAG, "reference readback failed");
+    for (int i = 1; i < ST77912_CALIB_PATTERNS; i++) {
+        // a bus that can't read back returns the same idle level for every pattern
+        ESP_GOTO_ON_FALSE(ref_crcs[i] != ref_crcs[0], ESP_ERR_NOT_SUPPORTED, err, TAG, "GRAM readback not available on this bus");
+    }
+
+    // patterns are written at the clock under test and always read back at start_hz, pclk_hz only drives writes
+    uint32_t stable_hz = start_hz;
+    int shift = 0;
+    for (uint32_t div = src_hz / start_hz; div >= 1; div--) {
+        uint32_t hz = spi_get_actual_clock(src_hz, src_hz / div, 128);
+        if (hz <= stable_hz) {
+            continue;
+        }
+        if (hz > calib_config->max_pclk_hz) {
+            break;
+        }
+
+        bool stable = true;
+        for (int round = 0; round < calib_config->rounds && stable; round++) {
+            shift = (shift + 1) % ST77912_CALIB_PATTERNS;
+            ESP_GOTO_ON_ERROR(calib_set_pclk(st77912, bus, &calib_io_config, hz), err, TAG, "switch pclk failed");
+            stable = calib_write(st77912, patterns, shift) == ESP_OK;
+            ESP_GOTO_ON_ERROR(calib_set_pclk(st77912, bus, &calib_io_config, start_hz), err, TAG, "switch pclk failed");
+            stable = stable && calib_read(st77912, rx_buf, rx_len, crcs) == ESP_OK;
+            for (int i = 0; i < ST77912_CALIB_PATTERNS && stable; i++) {
+                stable = crcs[i] == ref_crcs[(i + shift) % ST77912_CALIB_PATTERNS];
+            }
+        }
+        ESP_LOGD(TAG, "pclk %"PRIu32" Hz %s", hz, stable ? "stable" : "failed");
+        if (!stable) {
+            break;
+        }
+        stable_hz = hz;
+    }
+
+    // back off by the margin to the next clock the bus can really run at, a divider rounding up would eat it again
+    uint32_t target_hz = (uint64_t)stable_hz * (100 - calib_config->margin_percent) / 100;
+    uint32_t pclk_hz = start_hz;
+    if (target_hz > start_hz) {
+        uint32_t div = (src_hz + target_hz - 1) / target_hz;
+        pclk_hz = MAX(spi_get_actual_clock(src_hz, src_hz / div, 128), start_hz);
+    }
+    ESP_LOGI(TAG, "highest stable pclk %"PRIu32" Hz, using %"PRIu32" Hz", stable_hz, pclk_hz);
+    // the result is valid even if it can't be persisted
+    *ret_pclk_hz = pclk_hz;
+
+    if (calib_config->nvs_namespace) {
+        nvs_handle_t nvs = 0;
+        ESP_GOTO_ON_ERROR(nvs_open(calib_config->nvs_namespace, NVS_READWRITE, &nvs), err, TAG, "open NVS failed");
+        ret = nvs_set_u32(nvs, ST77912_CALIB_NVS_KEY, pclk_hz);
+        if (ret == ESP_OK) {
+            ret = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+        ESP_GOTO_ON_ERROR(ret, err, TAG, "store pclk to NVS failed");
+    }
+
+err:
+    if (st77912) {
+        io = st77912->io;
+        panel_st77912_del(panel);
+    }
+    if (io) {
+        esp_lcd_panel_io_del(io);
+    }
+    for (int i = 0; i < ST77912_CALIB_PATTERNS; i++) {
+        free(patterns[i]);
+    }
+    free(rx_buf);
+    return ret;
+}
+
+esp_err_t esp_lcd_st77912_load_pclk(const char *nvs_namespace, uint32_t *ret_pclk_hz)
+{
+    ESP_RETURN_ON_FALSE(nvs_namespace && ret_pclk_hz, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    nvs_handle_t nvs = 0;
+    uint32_t pclk_hz = 0;
+    esp_err_t ret = nvs_open(nvs_namespace, NVS_READONLY, &nvs);
+    if (ret == ESP_OK) {
+        ret = nvs_get_u32(nvs, ST77912_CALIB_NVS_KEY, &pclk_hz);
+        nvs_close(nvs);
+    }
+    if (ret == ESP_ERR_NVS_NOT_FOUND || (ret == ESP_OK && !pclk_hz)) {
+        // calibration never ran, the normal first boot, not worth an error log
+        return ESP_ERR_NOT_FOUND;
+    }
+    ESP_RETURN_ON_ERROR(ret, TAG, "read pclk from NVS failed");
+    *ret_pclk_hz = pclk_hz;
     return ESP_OK;
 }
\ No newline at end of file
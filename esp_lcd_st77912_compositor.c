@@ -0,0 +1,459 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_lcd_panel_commands.h"
+#include "esp_lcd_panel_ops.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "esp_lcd_st77912.h"
+#include "esp_lcd_st77912_compositor.h"
+
+#define COMP_BUF_NUM                (2)
+#define COMP_DIRTY_MAX              (4)
+
+// RGB565 spread over 32 bits as 00000GGGGGG00000RRRRR000000BBBBB, so R, G and B are blended in one multiply
+#define RGB565_SPREAD_MASK          (0x07E0F81FUL)
+
+static const char *TAG = "st77912_comp";
+
+typedef struct {
+    int x_start;
+    int y_start;
+    int x_end;
+    int y_end;
+} comp_area_t;
+
+typedef struct st77912_compositor_t {
+    esp_lcd_panel_handle_t panel;
+    esp_lcd_panel_io_handle_t io;
+    int h_res;
+    int v_res;
+    int band_lines;
+    uint16_t bg_color;
+    bool swap_bytes;
+    uint8_t max_layers;
+    uint8_t num_layers;
+    st77912_layer_config_t *layers;
+    comp_area_t dirty[COMP_DIRTY_MAX];
+    uint8_t num_dirty;
+    uint16_t *bufs[COMP_BUF_NUM];
+    int buf_idx;
+    SemaphoreHandle_t free_bufs;
+    int bands_in_flight;
+    portMUX_TYPE lock;
+    st77912_compositor_stats_t stats;
+} st77912_compositor_t;
+
+static inline uint16_t blend565(uint16_t fg, uint16_t bg, uint32_t a5)
+{
+    uint32_t f = (fg | ((uint32_t)fg << 16)) & RGB565_SPREAD_MASK;
+    uint32_t b = (bg | ((uint32_t)bg << 16)) & RGB565_SPREAD_MASK;
+    uint32_t r = ((((f - b) * a5) >> 5) + b) & RGB565_SPREAD_MASK;
+    return (uint16_t)(r | (r >> 16));
+}
+
+static inline __attribute__((always_inline)) void blend_row(uint16_t *dst, const uint16_t *src, int n, uint32_t a5,
+                                                            bool use_key, uint16_t key, bool swap)
+{
+    for (int i = 0; i < n; i++) {
+        uint16_t fg = src[i];
+        if (use_key && fg == key) {
+            continue;
+        }
+        if (swap) {
+            dst[i] = __builtin_bswap16(blend565(__builtin_bswap16(fg), __builtin_bswap16(dst[i]), a5));
+        } else {
+            dst[i] = blend565(fg, dst[i], a5);
+        }
+    }
+}
+
+// constant-folded variants of blend_row, picked once per layer row so the inner loop has no mode branches
+static void blend_row_alpha(uint16_t *dst, const uint16_t *src, int n, uint32_t a5, uint16_t key)
+{
+    blend_row(dst, src, n, a5, false, key, false);
+}
+
+static void blend_row_alpha_key(uint16_t *dst, const uint16_t *src, int n, uint32_t a5, uint16_t key)
+{
+    blend_row(dst, src, n, a5, true, key, false);
+}
+
+static void blend_row_alpha_swap(uint16_t *dst, const uint16_t *src, int n, uint32_t a5, uint16_t key)
+{
+    blend_row(dst, src, n, a5, false, key, true);
+}
+
+static void blend_row_alpha_key_swap(uint16_t *dst, const uint16_t *src, int n, uint32_t a5, uint16_t key)
+{
+    blend_row(dst, src, n, a5, true, key, true);
+}
+
+static void blend_row_key(uint16_t *dst, const uint16_t *src, int n, uint32_t a5, uint16_t key)
+{
+    // compare two pixels per 32-bit load when both are aligned the same way, the common case for full-width layers
+    int i = 0;
+    if ((((uintptr_t)dst ^ (uintptr_t)src) & 3) == 0) {
+        if ((uintptr_t)src & 3) {
+            if (src[0] != key) {
+                dst[0] = src[0];
+            }
+            i = 1;
+        }
+        uint32_t key2 = ((uint32_t)key << 16) | key;
+        for (; i + 1 < n; i += 2) {
+            uint32_t px;
+            memcpy(&px, &src[i], sizeof(px));
+            if (px == key2) {
+                continue;
+            }
+            if (((px ^ key2) & 0xFFFF) && ((px ^ key2) >> 16)) {
+                memcpy(&dst[i], &px, sizeof(px));
+                continue;
+            }
+            if (src[i] != key) {
+                dst[i] = src[i];
+            }
+            if (src[i + 1] != key) {
+                dst[i + 1] = src[i + 1];
+            }
+        }
+    }
+    for (; i < n; i++) {
+        if (src[i] != key) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+static void blend_row_copy(uint16_t *dst, const uint16_t *src, int n, uint32_t a5, uint16_t key)
+{
+    memcpy(dst, src, n * sizeof(uint16_t));
+}
+
+typedef void (*blend_row_fn_t)(uint16_t *dst, const uint16_t *src, int n, uint32_t a5, uint16_t key);
+
+static blend_row_fn_t select_kernel(const st77912_layer_config_t *layer, bool swap)
+{
+    bool key = layer->flags.use_color_key;
+    if (layer->alpha == 255) {
+        return key ? blend_row_key : blend_row_copy;
+    }
+    if (swap) {
+        return key ? blend_row_alpha_key_swap : blend_row_alpha_swap;
+    }
+    return key ? blend_row_alpha_key : blend_row_alpha;
+}
+
+static bool layer_opaque(const st77912_layer_config_t *layer)
+{
+    return layer->flags.visible && layer->alpha == 255 && !layer->flags.use_color_key;
+}
+
+static bool clip_area(const st77912_compositor_t *comp, comp_area_t *area)
+{
+    area->x_start = MAX(area->x_start, 0);
+    area->y_start = MAX(area->y_start, 0);
+    area->x_end = MIN(area->x_end, comp->h_res);
+    area->y_end = MIN(area->y_end, comp->v_res);
+    return area->x_start < area->x_end && area->y_start < area->y_end;
+}
+
+static int area_size(const comp_area_t *area)
+{
+    return (area->x_end - area->x_start) * (area->y_end - area->y_start);
+}
+
+static comp_area_t area_union(const comp_area_t *a, const comp_area_t *b)
+{
+    return (comp_area_t) {
+        MIN(a->x_start, b->x_start), MIN(a->y_start, b->y_start),
+        MAX(a->x_end, b->x_end), MAX(a->y_end, b->y_end),
+    };
+}
+
+static void mark_dirty(st77912_compositor_t *comp, comp_area_t area)
+{
+    if (!clip_area(comp, &area)) {
+        return;
+    }
+    // fold into an overlapping or touching area first
+    for (int i = 0; i < comp->num_dirty; i++) {
+        comp_area_t *d = &comp->dirty[i];
+        if (area.x_start <= d->x_end && d->x_start <= area.x_end && area.y_start <= d->y_end && d->y_start <= area.y_end) {
+            *d = area_union(d, &area);
+            return;
+        }
+    }
+    if (comp->num_dirty < COMP_DIRTY_MAX) {
+        comp->dirty[comp->num_dirty++] = area;
+        return;
+    }
+    // out of slots, merge into the area that grows the least
+    int best = 0;
+    int best_growth = INT32_MAX;
+    for (int i = 0; i < comp->num_dirty; i++) {
+        comp_area_t u = area_union(&comp->dirty[i], &area);
+        int growth = area_size(&u) - area_size(&comp->dirty[i]);
+        if (growth < best_growth) {
+            best_growth = growth;
+            best = i;
+        }
+    }
+    comp->dirty[best] = area_union(&comp->dirty[best], &area);
+}
+
+static void mark_layer_dirty(st77912_compositor_t *comp, const st77912_layer_config_t *layer)
+{
+    if (layer->flags.visible && layer->alpha) {
+        mark_dirty(comp, (comp_area_t) {
+            layer->x, layer->y, layer->x + layer->width, layer->y + layer->height
+        });
+    }
+}
+
+static bool IRAM_ATTR comp_color_trans_done(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
+{
+    st77912_compositor_t *comp = (st77912_compositor_t *)user_ctx;
+    BaseType_t need_yield = pdFALSE;
+    // other transfers on the same IO (a direct draw_bitmap) complete here too, only our bands free a buffer
+    portENTER_CRITICAL_ISR(&comp->lock);
+    bool ours = comp->bands_in_flight > 0;
+    if (ours) {
+        comp->bands_in_flight--;
+    }
+    portEXIT_CRITICAL_ISR(&comp->lock);
+    if (ours) {
+        xSemaphoreGiveFromISR(comp->free_bufs, &need_yield);
+    }
+    return need_yield == pdTRUE;
+}
+
+esp_err_t esp_lcd_st77912_compositor_new(const st77912_compositor_config_t *config, st77912_compositor_handle_t *ret_comp)
+{
+    ESP_RETURN_ON_FALSE(config && ret_comp && config->panel && config->io, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(config->h_res > 0 && config->v_res > 0 && config->band_lines > 0 && config->max_layers > 0,
+                        ESP_ERR_INVALID_ARG, TAG, "invalid geometry");
+
+    esp_err_t ret = ESP_OK;
+    st77912_compositor_t *comp = calloc(1, sizeof(st77912_compositor_t));
+    ESP_GOTO_ON_FALSE(comp, ESP_ERR_NO_MEM, err, TAG, "no mem for compositor");
+    comp->layers = calloc(config->max_layers, sizeof(st77912_layer_config_t));
+    ESP_GOTO_ON_FALSE(comp->layers, ESP_ERR_NO_MEM, err, TAG, "no mem for layers");
+
+    comp->band_lines = MIN(config->band_lines, config->v_res);
+    for (int i = 0; i < COMP_BUF_NUM; i++) {
+        comp->bufs[i] = heap_caps_malloc(config->h_res * comp->band_lines * sizeof(uint16_t), MALLOC_CAP_DMA);
+        ESP_GOTO_ON_FALSE(comp->bufs[i], ESP_ERR_NO_MEM, err, TAG, "no mem for band buffer");
+    }
+    comp->free_bufs = xSemaphoreCreateCounting(COMP_BUF_NUM, COMP_BUF_NUM);
+    ESP_GOTO_ON_FALSE(comp->free_bufs, ESP_ERR_NO_MEM, err, TAG, "no mem for buffer semaphore");
+    portMUX_INITIALIZE(&comp->lock);
+
+    const esp_lcd_panel_io_callbacks_t cbs = {
+        .on_color_trans_done = comp_color_trans_done,
+    };
+    ESP_GOTO_ON_ERROR(esp_lcd_panel_io_register_event_callbacks(config->io, &cbs, comp), err, TAG, "register IO callback failed");
+    comp->io = config->io;
+
+    comp->panel = config->panel;
+    comp->h_res = config->h_res;
+    comp->v_res = config->v_res;
+    comp->bg_color = config->bg_color;
+    comp->swap_bytes = config->flags.swap_bytes;
+    comp->max_layers = config->max_layers;
+    mark_dirty(comp, (comp_area_t) {
+        0, 0, comp->h_res, comp->v_res
+    });
+    *ret_comp = comp;
+    ESP_LOGD(TAG, "new compositor @%p", comp);
+    return ESP_OK;
+
+err:
+    if (comp) {
+        esp_lcd_st77912_compositor_del(comp);
+    }
+    return ret;
+}
+
+esp_err_t esp_lcd_st77912_compositor_del(st77912_compositor_handle_t comp)
+{
+    ESP_RETURN_ON_FALSE(comp, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    if (comp->free_bufs) {
+        // let in-flight bands finish before their buffers go away
+        for (int i = 0; i < COMP_BUF_NUM; i++) {
+            xSemaphoreTake(comp->free_bufs, portMAX_DELAY);
+        }
+    }
+    if (comp->io) {
+        // later transfers on the IO must not call back into freed memory
+        esp_lcd_panel_io_register_event_callbacks(comp->io, &(esp_lcd_panel_io_callbacks_t) {
+            0
+        }, NULL);
+    }
+    if (comp->free_bufs) {
+        vSemaphoreDelete(comp->free_bufs);
+    }
+    for (int i = 0; i < COMP_BUF_NUM; i++) {
+        free(comp->bufs[i]);
+    }
+    free(comp->layers);
+    free(comp);
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_compositor_add_layer(st77912_compositor_handle_t comp, const st77912_layer_config_t *layer_config, int *ret_layer)
+{
+    ESP_RETURN_ON_FALSE(comp && layer_config && ret_layer, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(layer_config->pixels && layer_config->width > 0 && layer_config->height > 0,
+                        ESP_ERR_INVALID_ARG, TAG, "invalid layer");
+    ESP_RETURN_ON_FALSE(comp->num_layers < comp->max_layers, ESP_ERR_NO_MEM, TAG, "no free layer");
+
+    int layer = comp->num_layers++;
+    comp->layers[layer] = *layer_config;
+    mark_layer_dirty(comp, &comp->layers[layer]);
+    *ret_layer = layer;
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_compositor_set_layer(st77912_compositor_handle_t comp, int layer, const st77912_layer_config_t *layer_config)
+{
+    ESP_RETURN_ON_FALSE(comp && layer_config, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(layer >= 0 && layer < comp->num_layers, ESP_ERR_INVALID_ARG, TAG, "invalid layer");
+    ESP_RETURN_ON_FALSE(layer_config->pixels && layer_config->width > 0 && layer_config->height > 0,
+                        ESP_ERR_INVALID_ARG, TAG, "invalid layer");
+
+    mark_layer_dirty(comp, &comp->layers[layer]);
+    comp->layers[layer] = *layer_config;
+    mark_layer_dirty(comp, &comp->layers[layer]);
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_compositor_invalidate(st77912_compositor_handle_t comp, int layer, int x_start, int y_start, int x_end, int y_end)
+{
+    ESP_RETURN_ON_FALSE(comp, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(layer >= 0 && layer < comp->num_layers, ESP_ERR_INVALID_ARG, TAG, "invalid layer");
+
+    const st77912_layer_config_t *l = &comp->layers[layer];
+    if (l->flags.visible && l->alpha) {
+        mark_dirty(comp, (comp_area_t) {
+            l->x + MAX(x_start, 0), l->y + MAX(y_start, 0),
+            l->x + MIN(x_end, l->width), l->y + MIN(y_end, l->height)
+        });
+    }
+    return ESP_OK;
+}
+
+static void compose_band(st77912_compositor_t *comp, uint16_t *buf, const comp_area_t *band)
+{
+    int width = band->x_end - band->x_start;
+
+    // the topmost opaque layer covering the whole band hides everything below it
+    int first = 0;
+    bool covered = false;
+    for (int i = comp->num_layers - 1; i >= 0; i--) {
+        const st77912_layer_config_t *l = &comp->layers[i];
+        if (layer_opaque(l) && l->x <= band->x_start && l->y <= band->y_start &&
+                l->x + l->width >= band->x_end && l->y + l->height >= band->y_end) {
+            first = i;
+            covered = true;
+            break;
+        }
+    }
+    if (!covered) {
+        uint16_t bg = comp->bg_color;
+        for (int i = 0; i < width * (band->y_end - band->y_start); i++) {
+            buf[i] = bg;
+        }
+    }
+
+    for (int i = first; i < comp->num_layers; i++) {
+        const st77912_layer_config_t *l = &comp->layers[i];
+        if (!l->flags.visible || !l->alpha) {
+            continue;
+        }
+        int x0 = MAX(l->x, band->x_start);
+        int x1 = MIN(l->x + l->width, band->x_end);
+        int y0 = MAX(l->y, band->y_start);
+        int y1 = MIN(l->y + l->height, band->y_end);
+        if (x0 >= x1 || y0 >= y1) {
+            continue;
+        }
+        blend_row_fn_t kernel = select_kernel(l, comp->swap_bytes);
+        // alpha 0..255 mapped to 0..32, the blend kernels work in 1/32 steps
+        uint32_t a5 = (l->alpha + 4) >> 3;
+        for (int y = y0; y < y1; y++) {
+            kernel(buf + (y - band->y_start) * width + (x0 - band->x_start),
+                   l->pixels + (y - l->y) * l->width + (x0 - l->x), x1 - x0, a5, l->color_key);
+        }
+    }
+}
+
+esp_err_t esp_lcd_st77912_compositor_flush(st77912_compositor_handle_t comp)
+{
+    ESP_RETURN_ON_FALSE(comp, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    if (comp->num_dirty) {
+        // a command waits for every queued transfer, so completions of pixels drawn around the compositor
+        // arrive now, before bands_in_flight starts counting ours
+        ESP_RETURN_ON_ERROR(esp_lcd_st77912_send_cmds(comp->panel, (const st77912_lcd_init_cmd_t []) {
+            {LCD_CMD_NOP, NULL, 0, 0},
+        }, 1), TAG, "send barrier failed");
+    }
+    for (int d = 0; d < comp->num_dirty; d++) {
+        const comp_area_t *area = &comp->dirty[d];
+        for (int y = area->y_start; y < area->y_end; y += comp->band_lines) {
+            comp_area_t band = {
+                area->x_start, y, area->x_end, MIN(y + comp->band_lines, area->y_end),
+            };
+            // completions arrive in submit order, so a free slot means the oldest buffer is done
+            xSemaphoreTake(comp->free_bufs, portMAX_DELAY);
+            uint16_t *buf = comp->bufs[comp->buf_idx];
+            int64_t start_us = esp_timer_get_time();
+            compose_band(comp, buf, &band);
+            comp->stats.compose_us += esp_timer_get_time() - start_us;
+
+            // counted before the transfer is queued, it may complete before draw_bitmap returns
+            portENTER_CRITICAL(&comp->lock);
+            comp->bands_in_flight++;
+            portEXIT_CRITICAL(&comp->lock);
+            esp_err_t ret = esp_lcd_panel_draw_bitmap(comp->panel, band.x_start, band.y_start, band.x_end, band.y_end, buf);
+            if (ret != ESP_OK) {
+                portENTER_CRITICAL(&comp->lock);
+                comp->bands_in_flight--;
+                portEXIT_CRITICAL(&comp->lock);
+                xSemaphoreGive(comp->free_bufs);
+                // keep what is left of this area dirty for the next flush
+                comp->dirty[0] = (comp_area_t) {
+                    area->x_start, band.y_start, area->x_end, area->y_end
+                };
+                memmove(&comp->dirty[1], &comp->dirty[d + 1], (comp->num_dirty - d - 1) * sizeof(comp_area_t));
+                comp->num_dirty -= d;
+                ESP_RETURN_ON_ERROR(ret, TAG, "draw band failed");
+            }
+            comp->buf_idx = (comp->buf_idx + 1) % COMP_BUF_NUM;
+            comp->stats.bands++;
+            comp->stats.composed_pixels += area_size(&band);
+            comp->stats.sent_bytes += area_size(&band) * sizeof(uint16_t);
+        }
+    }
+    comp->num_dirty = 0;
+    comp->stats.flushes++;
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_compositor_get_stats(st77912_compositor_handle_t comp, st77912_compositor_stats_t *ret_stats)
+{
+    ESP_RETURN_ON_FALSE(comp && ret_stats, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    *ret_stats = comp->stats;
+    return ESP_OK;
+}
@@ -0,0 +1,262 @@
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "esp_lcd_st77912_governor.h"
+
+#define GOV_NO_MODE                 (UINT32_MAX)
+
+static const char *TAG = "st77912_gov";
+
+typedef struct st77912_governor_t {
+    esp_lcd_panel_handle_t panel;
+    uint32_t screen_pixels;
+    st77912_governor_mode_t modes[ST77912_GOVERNOR_MAX_MODES];
+    uint8_t num_modes;
+    int64_t window_us;
+    int64_t hold_us;
+    uint64_t bus_bits_per_sec;
+    uint32_t static_uw;
+    uint32_t uw_per_hz;
+    uint32_t bus_active_uw;
+    st77912_governor_mode_cb_t on_mode_change;
+    void *user_ctx;
+
+    // written by the draw hook, possibly from another task
+    portMUX_TYPE lock;
+    uint64_t win_pixels;
+    uint64_t win_bytes;
+    volatile bool reapply;
+
+    uint32_t cur;
+    uint32_t applied;           // mode whose registers are in the panel, GOV_NO_MODE if unknown
+    uint32_t notify_from;       // old mode to report once the registers are written, GOV_NO_MODE if none
+    int64_t created_us;
+    int64_t win_start_us;
+    int64_t quiet_since_us;     // start of the current quiet stretch, -1 while busy
+    int64_t accounted_us;
+    uint64_t time_us[ST77912_GOVERNOR_MAX_MODES];
+    uint64_t energy_pj;         // uW * us
+    int64_t next_frame_us;      // deadline of the next wait_frame() slot
+    bool paced;
+    st77912_governor_stats_t stats;
+} st77912_governor_t;
+
+static void gov_on_draw(esp_lcd_panel_handle_t panel, int x_start, int y_start, int x_end, int y_end, size_t bytes, void *user_ctx)
+{
+    st77912_governor_t *gov = (st77912_governor_t *)user_ctx;
+    portENTER_CRITICAL(&gov->lock);
+    gov->win_pixels += (uint32_t)((x_end - x_start) * (y_end - y_start));
+    gov->win_bytes += bytes;
+    portEXIT_CRITICAL(&gov->lock);
+}
+
+static void gov_on_init(esp_lcd_panel_handle_t panel, void *user_ctx)
+{
+    st77912_governor_t *gov = (st77912_governor_t *)user_ctx;
+    // the init table restored the vendor frame rate
+    gov->reapply = true;
+}
+
+static void gov_account(st77912_governor_t *gov, int64_t now)
+{
+    int64_t dt = now - gov->accounted_us;
+    gov->time_us[gov->cur] += dt;
+    gov->energy_pj += (uint64_t)gov->stats.power_uw * dt;
+    gov->accounted_us = now;
+}
+
+static uint32_t gov_next_mode(st77912_governor_t *gov, int64_t now, uint32_t activity)
+{
+    uint32_t next = gov->cur;
+    while (next + 1 < gov->num_modes && activity >= gov->modes[next + 1].enter_percent) {
+        next++;
+    }
+    if (next > gov->cur) {
+        // step up right away, an animation should not wait for hold_ms
+        gov->quiet_since_us = -1;
+        return next;
+    }
+    if (gov->cur == 0 || activity >= gov->modes[gov->cur].exit_percent) {
+        gov->quiet_since_us = -1;
+        return gov->cur;
+    }
+    if (gov->quiet_since_us < 0) {
+        gov->quiet_since_us = gov->win_start_us;
+    }
+    if (now - gov->quiet_since_us < gov->hold_us) {
+        return gov->cur;
+    }
+    // one mode at a time, every further step needs another quiet hold_ms
+    gov->quiet_since_us = now;
+    return gov->cur - 1;
+}
+
+static void gov_evaluate(st77912_governor_t *gov, int64_t now)
+{
+    int64_t elapsed = now - gov->win_start_us;
+    portENTER_CRITICAL(&gov->lock);
+    uint64_t pixels = gov->win_pixels;
+    uint64_t bytes = gov->win_bytes;
+    gov->win_pixels = 0;
+    gov->win_bytes = 0;
+    portEXIT_CRITICAL(&gov->lock);
+
+    uint32_t activity = pixels * 100 * 1000000 / gov->screen_pixels / elapsed;
+    uint64_t busy_us = MIN(bytes * 8 * 1000000 / gov->bus_bits_per_sec, (uint64_t)elapsed);
+    gov->stats.activity_percent = activity;
+    gov->stats.bus_percent = busy_us * 100 / elapsed;
+    gov->stats.power_uw = gov->static_uw + gov->uw_per_hz * gov->modes[gov->cur].panel_hz +
+                          (uint64_t)gov->bus_active_uw * busy_us / elapsed;
+
+    uint32_t next = gov_next_mode(gov, now, activity);
+    gov->win_start_us = now;
+    if (next != gov->cur) {
+        ESP_LOGD(TAG, "mode %"PRIu32" -> %"PRIu32", activity %"PRIu32"%%/s", gov->cur, next, activity);
+        if (gov->notify_from == GOV_NO_MODE) {
+            gov->notify_from = gov->cur;
+        }
+        gov->cur = next;
+        gov->stats.mode_switches++;
+    }
+}
+
+esp_err_t esp_lcd_st77912_governor_new(const st77912_governor_config_t *config, st77912_governor_handle_t *ret_gov)
+{
+    ESP_RETURN_ON_FALSE(config && ret_gov && config->panel && config->modes, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(config->num_modes > 0 && config->num_modes <= ST77912_GOVERNOR_MAX_MODES && config->initial_mode < config->num_modes,
+                        ESP_ERR_INVALID_ARG, TAG, "invalid mode table");
+    ESP_RETURN_ON_FALSE(config->h_res > 0 && config->v_res > 0 && config->window_ms > 0 && config->pclk_hz > 0 && config->data_lines > 0,
+                        ESP_ERR_INVALID_ARG, TAG, "invalid geometry or bus");
+    for (int i = 0; i < config->num_modes; i++) {
+        ESP_RETURN_ON_FALSE(config->modes[i].host_fps > 0, ESP_ERR_INVALID_ARG, TAG, "mode %d has no host rate", i);
+    }
+
+    esp_err_t ret = ESP_OK;
+    st77912_governor_t *gov = calloc(1, sizeof(st77912_governor_t));
+    ESP_RETURN_ON_FALSE(gov, ESP_ERR_NO_MEM, TAG, "no mem for governor");
+
+    gov->panel = config->panel;
+    gov->screen_pixels = config->h_res * config->v_res;
+    memcpy(gov->modes, config->modes, config->num_modes * sizeof(st77912_governor_mode_t));
+    gov->num_modes = config->num_modes;
+    gov->window_us = config->window_ms * 1000LL;
+    gov->hold_us = config->hold_ms * 1000LL;
+    gov->bus_bits_per_sec = (uint64_t)config->pclk_hz * config->data_lines;
+    gov->static_uw = config->power.static_uw;
+    gov->uw_per_hz = config->power.uw_per_hz;
+    gov->bus_active_uw = config->power.bus_active_uw;
+    gov->on_mode_change = config->on_mode_change;
+    gov->user_ctx = config->user_ctx;
+    portMUX_INITIALIZE(&gov->lock);
+
+    gov->cur = config->initial_mode;
+    gov->applied = GOV_NO_MODE;
+    gov->notify_from = GOV_NO_MODE;
+    gov->created_us = esp_timer_get_time();
+    gov->win_start_us = gov->created_us;
+    gov->accounted_us = gov->created_us;
+    gov->quiet_since_us = -1;
+    gov->stats.power_uw = gov->static_uw + gov->uw_per_hz * gov->modes[gov->cur].panel_hz;
+
+    const st77912_panel_hooks_t hooks = {
+        .on_draw = gov_on_draw,
+        .on_init = gov_on_init,
+        .user_ctx = gov,
+    };
+    ESP_GOTO_ON_ERROR(esp_lcd_st77912_set_hooks(config->panel, &hooks), err, TAG, "set panel hooks failed");
+
+    *ret_gov = gov;
+    return ESP_OK;
+
+err:
+    free(gov);
+    return ret;
+}
+
+esp_err_t esp_lcd_st77912_governor_del(st77912_governor_handle_t gov)
+{
+    ESP_RETURN_ON_FALSE(gov, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    // only our own hooks, they may have been replaced after the governor was created
+    st77912_panel_hooks_t hooks;
+    if (esp_lcd_st77912_get_hooks(gov->panel, &hooks) == ESP_OK && hooks.user_ctx == gov && hooks.on_draw == gov_on_draw) {
+        esp_lcd_st77912_set_hooks(gov->panel, NULL);
+    }
+    free(gov);
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_governor_update(st77912_governor_handle_t gov)
+{
+    ESP_RETURN_ON_FALSE(gov, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    int64_t now = esp_timer_get_time();
+    gov_account(gov, now);
+    if (now - gov->win_start_us >= gov->window_us) {
+        gov_evaluate(gov, now);
+    }
+
+    if (gov->reapply) {
+        gov->reapply = false;
+        gov->applied = GOV_NO_MODE;
+    }
+    if (gov->applied != gov->cur) {
+        const st77912_governor_mode_t *mode = &gov->modes[gov->cur];
+        // left pending on failure, the next call tries again
+        ESP_RETURN_ON_ERROR(esp_lcd_st77912_send_cmds(gov->panel, mode->cmds, mode->cmds ? mode->cmds_size : 0),
+                            TAG, "write frame-rate registers failed");
+        gov->applied = gov->cur;
+    }
+    if (gov->notify_from != GOV_NO_MODE) {
+        uint32_t old_mode = gov->notify_from;
+        gov->notify_from = GOV_NO_MODE;
+        if (old_mode != gov->cur && gov->on_mode_change) {
+            gov->on_mode_change(gov, old_mode, gov->cur, &gov->modes[gov->cur], gov->user_ctx);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_governor_wait_frame(st77912_governor_handle_t gov)
+{
+    ESP_RETURN_ON_ERROR(esp_lcd_st77912_governor_update(gov), TAG, "update failed");
+
+    // paced against an absolute deadline in us, so rounding the period to ms and ticks doesn't add up over frames
+    int64_t now_us = esp_timer_get_time();
+    if (!gov->paced) {
+        gov->next_frame_us = now_us;
+        gov->paced = true;
+    }
+    gov->next_frame_us += 1000000 / gov->modes[gov->cur].host_fps;
+    if (gov->next_frame_us <= now_us) {
+        // the frame ran late, don't burst to catch up
+        gov->next_frame_us = now_us;
+        return ESP_OK;
+    }
+    vTaskDelay(pdMS_TO_TICKS((gov->next_frame_us - now_us) / 1000));
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_governor_get_stats(st77912_governor_handle_t gov, st77912_governor_stats_t *ret_stats)
+{
+    ESP_RETURN_ON_FALSE(gov && ret_stats, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    *ret_stats = gov->stats;
+    ret_stats->mode = gov->cur;
+    for (int i = 0; i < gov->num_modes; i++) {
+        ret_stats->time_in_mode_ms[i] = gov->time_us[i] / 1000;
+    }
+    int64_t span = gov->accounted_us - gov->created_us;
+    if (span > 0) {
+        ret_stats->avg_power_uw = gov->energy_pj / span;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,653 @@
+#include <string.h>
+
+#include "esp_lcd_st77912_jpeg.h"
+
+#define JPEG_PLANE_STRIDE           ST77912_JPEG_MAX_MCU_LINES
+
+#define JPEG_MARKER_SOF0            (0xC0)
+#define JPEG_MARKER_SOF1            (0xC1)
+#define JPEG_MARKER_DHT             (0xC4)
+#define JPEG_MARKER_RST0            (0xD0)
+#define JPEG_MARKER_RST7            (0xD7)
+#define JPEG_MARKER_SOI             (0xD8)
+#define JPEG_MARKER_EOI             (0xD9)
+#define JPEG_MARKER_SOS             (0xDA)
+#define JPEG_MARKER_DQT             (0xDB)
+#define JPEG_MARKER_DRI             (0xDD)
+#define JPEG_MARKER_TEM             (0x01)
+
+#define BIT_HUFF(tc, th)            (1U << ((tc) * ST77912_JPEG_MAX_TABLES + (th)))
+
+// fixed point constants of the integer IDCT, 12 fractional bits
+#define F2F(x)                      ((int32_t)((x) * 4096 + 0.5))
+
+static const uint8_t s_zigzag[64 + 16] = {
+    0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63,
+    // a corrupt run can point past the block, keep those writes in bounds
+    63, 63, 63, 63, 63, 63, 63, 63,
+    63, 63, 63, 63, 63, 63, 63, 63,
+};
+
+// ITU T.81 Annex K.3 tables, for Motion-JPEG frames that leave out DHT (e.g. AVI MJPEG)
+static const uint8_t s_std_dc_lum_counts[16] = {
+    0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00,
+};
+
+static const uint8_t s_std_dc_lum_values[12] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+};
+
+static const uint8_t s_std_dc_chrom_counts[16] = {
+    0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00,
+};
+
+static const uint8_t s_std_dc_chrom_values[12] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+};
+
+static const uint8_t s_std_ac_lum_counts[16] = {
+    0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04, 0x04,
+    0x00, 0x00, 0x01, 0x7D,
+};
+
+static const uint8_t s_std_ac_lum_values[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06,
+    0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08,
+    0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0, 0x24, 0x33, 0x62, 0x72,
+    0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+    0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x73, 0x74, 0x75,
+    0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3,
+    0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6,
+    0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9,
+    0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4,
+    0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA,
+};
+
+static const uint8_t s_std_ac_chrom_counts[16] = {
+    0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04,
+    0x00, 0x01, 0x02, 0x77,
+};
+
+static const uint8_t s_std_ac_chrom_values[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41,
+    0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+    0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0, 0x15, 0x62, 0x72, 0xD1,
+    0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+    0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44,
+    0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+    0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x73, 0x74,
+    0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A,
+    0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4,
+    0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7,
+    0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+    0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4,
+    0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA,
+};
+
+static inline uint16_t read_u16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static inline uint8_t clamp_u8(int32_t x)
+{
+    return x < 0 ? 0 : (x > 255 ? 255 : x);
+}
+
+static esp_err_t build_huff(st77912_jpeg_huff_t *h, const uint8_t *counts, const uint8_t *symbols, int num_symbols)
+{
+    int32_t code = 0;
+    int k = 0;
+
+    memset(h->fast, 0, sizeof(h->fast));
+    memcpy(h->values, symbols, num_symbols);
+    for (int l = 1; l <= 16; l++) {
+        h->valptr[l] = k;
+        h->mincode[l] = code;
+        for (int i = 0; i < counts[l - 1]; i++, k++, code++) {
+            if (code >= (1 << l)) {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            if (l <= ST77912_JPEG_FAST_BITS) {
+                int shift = ST77912_JPEG_FAST_BITS - l;
+                for (int j = 0; j < (1 << shift); j++) {
+                    h->fast[(code << shift) + j] = (l << 8) | symbols[k];
+                }
+            }
+        }
+        h->maxcode[l] = counts[l - 1] ? code - 1 : -1;
+        code <<= 1;
+    }
+    return ESP_OK;
+}
+
+static void load_std_huff(st77912_jpeg_dec_t *dec, int tc, int th)
+{
+    if (dec->huff_defined & BIT_HUFF(tc, th)) {
+        return;
+    }
+    if (tc) {
+        build_huff(&dec->ac_huff[th], th ? s_std_ac_chrom_counts : s_std_ac_lum_counts,
+                   th ? s_std_ac_chrom_values : s_std_ac_lum_values, sizeof(s_std_ac_lum_values));
+    } else {
+        build_huff(&dec->dc_huff[th], th ? s_std_dc_chrom_counts : s_std_dc_lum_counts,
+                   th ? s_std_dc_chrom_values : s_std_dc_lum_values, sizeof(s_std_dc_lum_values));
+    }
+    dec->huff_defined |= BIT_HUFF(tc, th);
+}
+
+static void fill_bits(st77912_jpeg_dec_t *dec)
+{
+    while (dec->bit_cnt <= 24) {
+        uint32_t b = 0;
+        if (!dec->marker_hit && dec->pos < dec->len) {
+            b = dec->data[dec->pos++];
+            if (b == 0xFF) {
+                uint8_t next = dec->pos < dec->len ? dec->data[dec->pos] : JPEG_MARKER_EOI;
+                if (next == 0x00) {
+                    dec->pos++;
+                } else {
+                    // leave pos on the marker and feed zeros from here on
+                    dec->marker_hit = true;
+                    dec->pos--;
+                    b = 0;
+                }
+            }
+        }
+        dec->bit_buf |= b << (24 - dec->bit_cnt);
+        dec->bit_cnt += 8;
+    }
+}
+
+static inline uint32_t get_bits(st77912_jpeg_dec_t *dec, int n)
+{
+    fill_bits(dec);
+    uint32_t v = dec->bit_buf >> (32 - n);
+    dec->bit_buf <<= n;
+    dec->bit_cnt -= n;
+    return v;
+}
+
+static inline int32_t extend(uint32_t v, int n)
+{
+    return v < (1U << (n - 1)) ? (int32_t)v - (1 << n) + 1 : (int32_t)v;
+}
+
+static inline int huff_decode(st77912_jpeg_dec_t *dec, const st77912_jpeg_huff_t *h)
+{
+    fill_bits(dec);
+    uint16_t f = h->fast[dec->bit_buf >> (32 - ST77912_JPEG_FAST_BITS)];
+    if (f) {
+        dec->bit_buf <<= f >> 8;
+        dec->bit_cnt -= f >> 8;
+        return f & 0xFF;
+    }
+    for (int l = ST77912_JPEG_FAST_BITS + 1; l <= 16; l++) {
+        int32_t code = dec->bit_buf >> (32 - l);
+        if (code <= h->maxcode[l]) {
+            dec->bit_buf <<= l;
+            dec->bit_cnt -= l;
+            return h->values[h->valptr[l] + code - h->mincode[l]];
+        }
+    }
+    return -1;
+}
+
+// Integer IDCT (islow), columns first with 10 bits kept, then rows
+#define IDCT_1D(s0, s1, s2, s3, s4, s5, s6, s7)                                     \
+    int32_t t0, t1, t2, t3, p1, p2, p3, p4, p5, x0, x1, x2, x3;                     \
+    p2 = s2;                                                                        \
+    p3 = s6;                                                                        \
+    p1 = (p2 + p3) * F2F(0.5411961f);                                               \
+    t2 = p1 + p3 * F2F(-1.847759065f);                                              \
+    t3 = p1 + p2 * F2F(0.765366865f);                                               \
+    p2 = s0;                                                                        \
+    p3 = s4;                                                                        \
+    t0 = (p2 + p3) * 4096;                                                          \
+    t1 = (p2 - p3) * 4096;                                                          \
+    x0 = t0 + t3;                                                                   \
+    x3 = t0 - t3;                                                                   \
+    x1 = t1 + t2;                                                                   \
+    x2 = t1 - t2;                                                                   \
+    t0 = s7;                                                                        \
+    t1 = s5;                                                                        \
+    t2 = s3;                                                                        \
+    t3 = s1;                                                                        \
+    p3 = t0 + t2;                                                                   \
+    p4 = t1 + t3;                                                                   \
+    p1 = t0 + t3;                                                                   \
+    p2 = t1 + t2;                                                                   \
+    p5 = (p3 + p4) * F2F(1.175875602f);                                             \
+    t0 = t0 * F2F(0.298631336f);                                                    \
+    t1 = t1 * F2F(2.053119869f);                                                    \
+    t2 = t2 * F2F(3.072711026f);                                                    \
+    t3 = t3 * F2F(1.501321110f);                                                    \
+    p1 = p5 + p1 * F2F(-0.899976223f);                                              \
+    p2 = p5 + p2 * F2F(-2.562915447f);                                              \
+    p3 = p3 * F2F(-1.961570560f);                                                   \
+    p4 = p4 * F2F(-0.390180644f);                                                   \
+    t3 += p1 + p4;                                                                  \
+    t2 += p2 + p3;                                                                  \
+    t1 += p2 + p4;                                                                  \
+    t0 += p1 + p3;
+
+static void idct_block(const int16_t *in, uint8_t *out, int out_stride)
+{
+    int32_t tmp[64];
+
+    for (int i = 0; i < 8; i++) {
+        const int16_t *d = in + i;
+        int32_t *v = tmp + i;
+        if (!d[8] && !d[16] && !d[24] && !d[32] && !d[40] && !d[48] && !d[56]) {
+            int32_t dc = d[0] * 4;
+            v[0] = v[8] = v[16] = v[24] = v[32] = v[40] = v[48] = v[56] = dc;
+            continue;
+        }
+        IDCT_1D(d[0], d[8], d[16], d[24], d[32], d[40], d[48], d[56]);
+        x0 += 512;
+        x1 += 512;
+        x2 += 512;
+        x3 += 512;
+        v[0] = (x0 + t3) >> 10;
+        v[56] = (x0 - t3) >> 10;
+        v[8] = (x1 + t2) >> 10;
+        v[48] = (x1 - t2) >> 10;
+        v[16] = (x2 + t1) >> 10;
+        v[40] = (x2 - t1) >> 10;
+        v[24] = (x3 + t0) >> 10;
+        v[32] = (x3 - t0) >> 10;
+    }
+
+    for (int i = 0; i < 8; i++) {
+        const int32_t *v = tmp + i * 8;
+        uint8_t *o = out + i * out_stride;
+        IDCT_1D(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+        // rounding plus the +128 level shift, folded into the 17-bit descale
+        x0 += 65536 + (128 << 17);
+        x1 += 65536 + (128 << 17);
+        x2 += 65536 + (128 << 17);
+        x3 += 65536 + (128 << 17);
+        o[0] = clamp_u8((x0 + t3) >> 17);
+        o[7] = clamp_u8((x0 - t3) >> 17);
+        o[1] = clamp_u8((x1 + t2) >> 17);
+        o[6] = clamp_u8((x1 - t2) >> 17);
+        o[2] = clamp_u8((x2 + t1) >> 17);
+        o[5] = clamp_u8((x2 - t1) >> 17);
+        o[3] = clamp_u8((x3 + t0) >> 17);
+        o[4] = clamp_u8((x3 - t0) >> 17);
+    }
+}
+
+static esp_err_t decode_block(st77912_jpeg_dec_t *dec, int c, uint8_t *out)
+{
+    int16_t coef[64];
+    const uint16_t *q = dec->qt[dec->comps[c].tq];
+    const st77912_jpeg_huff_t *ac = &dec->ac_huff[dec->comps[c].ta];
+
+    int t = huff_decode(dec, &dec->dc_huff[dec->comps[c].td]);
+    if (t < 0 || t > 11) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    dec->comps[c].dc_pred += t ? extend(get_bits(dec, t), t) : 0;
+    int32_t dc = dec->comps[c].dc_pred * q[0];
+
+    bool dc_only = true;
+    memset(coef, 0, sizeof(coef));
+    coef[0] = dc;
+    for (int k = 1; k < 64;) {
+        int rs = huff_decode(dec, ac);
+        if (rs < 0) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        int r = rs >> 4;
+        int s = rs & 0x0F;
+        if (!s) {
+            if (r != 15) {
+                break;
+            }
+            k += 16;
+            continue;
+        }
+        k += r;
+        if (k > 63) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        coef[s_zigzag[k]] = extend(get_bits(dec, s), s) * q[k];
+        dc_only = false;
+        k++;
+    }
+
+    if (dc_only) {
+        // flat block, the IDCT reduces to the scaled DC term
+        uint8_t v = clamp_u8(((dc + 4) >> 3) + 128);
+        for (int y = 0; y < 8; y++) {
+            memset(out + y * JPEG_PLANE_STRIDE, v, 8);
+        }
+        return ESP_OK;
+    }
+    idct_block(coef, out, JPEG_PLANE_STRIDE);
+    return ESP_OK;
+}
+
+static esp_err_t restart(st77912_jpeg_dec_t *dec)
+{
+    // skip the padding bits, the RSTn marker is at most a few bytes ahead of the bit reader
+    while (dec->pos + 1 < dec->len && !(dec->data[dec->pos] == 0xFF &&
+                                        dec->data[dec->pos + 1] >= JPEG_MARKER_RST0 && dec->data[dec->pos + 1] <= JPEG_MARKER_RST7)) {
+        dec->pos++;
+    }
+    if (dec->pos + 1 >= dec->len) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    dec->pos += 2;
+    dec->bit_buf = 0;
+    dec->bit_cnt = 0;
+    dec->marker_hit = false;
+    for (int c = 0; c < dec->num_comps; c++) {
+        dec->comps[c].dc_pred = 0;
+    }
+    dec->mcus_to_restart = dec->restart_interval;
+    return ESP_OK;
+}
+
+static void put_pixel(uint16_t *dst, int y, int cb, int cr, bool swap_bytes)
+{
+    // BT.601 full range, 16 fractional bits
+    cb -= 128;
+    cr -= 128;
+    int r = clamp_u8(y + ((91881 * cr + 32768) >> 16));
+    int g = clamp_u8(y + ((-22554 * cb - 46802 * cr + 32768) >> 16));
+    int b = clamp_u8(y + ((116130 * cb + 32768) >> 16));
+    uint16_t px = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+    *dst = swap_bytes ? __builtin_bswap16(px) : px;
+}
+
+esp_err_t esp_lcd_st77912_jpeg_start(st77912_jpeg_dec_t *dec, const uint8_t *data, size_t len)
+{
+    if (!dec || !data || len < 4) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (data[0] != 0xFF || data[1] != JPEG_MARKER_SOI) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    memset(dec, 0, offsetof(st77912_jpeg_dec_t, qt));
+    dec->data = data;
+    dec->len = len;
+    size_t pos = 2;
+    bool have_frame = false;
+
+    while (pos + 4 <= len) {
+        if (data[pos] != 0xFF) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            pos++;
+            continue;
+        }
+        if (marker == JPEG_MARKER_EOI) {
+            break;
+        }
+        if (marker == JPEG_MARKER_TEM || (marker >= JPEG_MARKER_RST0 && marker <= JPEG_MARKER_RST7)) {
+            pos += 2;
+            continue;
+        }
+        uint16_t seg_len = read_u16(&data[pos + 2]);
+        const uint8_t *p = &data[pos + 4];
+        const uint8_t *end = &data[pos + 2] + seg_len;
+        if (seg_len < 2 || pos + 2 + seg_len > len) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+
+        switch (marker) {
+        case JPEG_MARKER_DQT:
+            while (p < end) {
+                int pq = p[0] >> 4;
+                int tq = p[0] & 0x0F;
+                if (pq) {
+                    // 16-bit tables belong to 12-bit frames, with 8-bit samples they overflow the coefficients
+                    return ESP_ERR_NOT_SUPPORTED;
+                }
+                if (tq > 3 || p + 1 + 64 > end) {
+                    return ESP_ERR_INVALID_RESPONSE;
+                }
+                p++;
+                for (int k = 0; k < 64; k++) {
+                    dec->qt[tq][k] = p[k];
+                }
+                p += 64;
+            }
+            break;
+        case JPEG_MARKER_DHT:
+            while (p + 17 <= end) {
+                int tc = p[0] >> 4;
+                int th = p[0] & 0x0F;
+                int num_symbols = 0;
+                for (int i = 0; i < 16; i++) {
+                    num_symbols += p[1 + i];
+                }
+                if (tc > 1 || num_symbols > 256 || p + 17 + num_symbols > end) {
+                    return ESP_ERR_INVALID_RESPONSE;
+                }
+                if (th >= ST77912_JPEG_MAX_TABLES) {
+                    return ESP_ERR_NOT_SUPPORTED;
+                }
+                st77912_jpeg_huff_t *h = tc ? &dec->ac_huff[th] : &dec->dc_huff[th];
+                if (build_huff(h, p + 1, p + 17, num_symbols) != ESP_OK) {
+                    return ESP_ERR_INVALID_RESPONSE;
+                }
+                dec->huff_defined |= BIT_HUFF(tc, th);
+                p += 17 + num_symbols;
+            }
+            break;
+        case JPEG_MARKER_SOF0:
+        case JPEG_MARKER_SOF1:
+            if (seg_len < 8 || p[0] != 8) {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            dec->height = read_u16(&p[1]);
+            dec->width = read_u16(&p[3]);
+            dec->num_comps = p[5];
+            if (!dec->width || !dec->height) {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            if ((dec->num_comps != 1 && dec->num_comps != 3) || seg_len < 8 + dec->num_comps * 3) {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            for (int c = 0; c < dec->num_comps; c++) {
+                dec->comps[c].id = p[6 + c * 3];
+                dec->comps[c].h = p[7 + c * 3] >> 4;
+                dec->comps[c].v = p[7 + c * 3] & 0x0F;
+                dec->comps[c].tq = p[8 + c * 3] & 0x03;
+            }
+            if (dec->num_comps == 1) {
+                // a single component is never interleaved, so its MCU is one block whatever the header says
+                dec->comps[0].h = dec->comps[0].v = 1;
+            } else if (dec->comps[0].h < 1 || dec->comps[0].h > 2 || dec->comps[0].v < 1 || dec->comps[0].v > 2 ||
+                       dec->comps[1].h != 1 || dec->comps[1].v != 1 || dec->comps[2].h != 1 || dec->comps[2].v != 1) {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            dec->mcu_w = dec->comps[0].h * 8;
+            dec->mcu_h = dec->comps[0].v * 8;
+            dec->mcus_x = (dec->width + dec->mcu_w - 1) / dec->mcu_w;
+            dec->mcus_y = (dec->height + dec->mcu_h - 1) / dec->mcu_h;
+            have_frame = true;
+            break;
+        case JPEG_MARKER_DRI:
+            if (seg_len < 4) {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            dec->restart_interval = read_u16(p);
+            break;
+        case JPEG_MARKER_SOS:
+            if (!have_frame) {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            // Ns, a selector pair per component, then Ss, Se and Ah/Al
+            if (seg_len < 3 || seg_len < 6 + p[0] * 2) {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            if (p[0] != dec->num_comps) {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            for (int i = 0; i < dec->num_comps; i++) {
+                if (p[1 + i * 2] != dec->comps[i].id) {
+                    return ESP_ERR_NOT_SUPPORTED;
+                }
+                dec->comps[i].td = p[2 + i * 2] >> 4;
+                dec->comps[i].ta = p[2 + i * 2] & 0x0F;
+                if (dec->comps[i].td >= ST77912_JPEG_MAX_TABLES || dec->comps[i].ta >= ST77912_JPEG_MAX_TABLES) {
+                    return ESP_ERR_NOT_SUPPORTED;
+                }
+                load_std_huff(dec, 0, dec->comps[i].td);
+                load_std_huff(dec, 1, dec->comps[i].ta);
+            }
+            dec->pos = pos + 2 + seg_len;
+            dec->mcus_to_restart = dec->restart_interval;
+            return ESP_OK;
+        default:
+            if (marker >= 0xC2 && marker <= 0xCF && marker != JPEG_MARKER_DHT && marker != 0xC8 && marker != 0xCC) {
+                // progressive, lossless, arithmetic or hierarchical frames
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            break;
+        }
+        pos += 2 + seg_len;
+    }
+    return ESP_ERR_INVALID_RESPONSE;
+}
+
+esp_err_t esp_lcd_st77912_jpeg_decode_rows(st77912_jpeg_dec_t *dec, uint16_t *out, int out_stride, bool swap_bytes, int *ret_lines)
+{
+    if (!dec || !out || !ret_lines || out_stride < dec->width) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (dec->mcu_row >= dec->mcus_y) {
+        *ret_lines = 0;
+        return ESP_OK;
+    }
+
+    int lines = dec->height - dec->mcu_row * dec->mcu_h;
+    if (lines > dec->mcu_h) {
+        lines = dec->mcu_h;
+    }
+    int hs = dec->comps[0].h - 1;
+    int vs = dec->comps[0].v - 1;
+
+    for (int mx = 0; mx < dec->mcus_x; mx++) {
+        if (dec->restart_interval) {
+            if (!dec->mcus_to_restart) {
+                esp_err_t ret = restart(dec);
+                if (ret != ESP_OK) {
+                    return ret;
+                }
+            }
+            dec->mcus_to_restart--;
+        }
+
+        for (int c = 0; c < dec->num_comps; c++) {
+            for (int by = 0; by < dec->comps[c].v; by++) {
+                for (int bx = 0; bx < dec->comps[c].h; bx++) {
+                    esp_err_t ret = decode_block(dec, c, &dec->planes[c][by * 8 * JPEG_PLANE_STRIDE + bx * 8]);
+                    if (ret != ESP_OK) {
+                        return ret;
+                    }
+                }
+            }
+        }
+
+        int x0 = mx * dec->mcu_w;
+        int cols = dec->width - x0;
+        if (cols > dec->mcu_w) {
+            cols = dec->mcu_w;
+        }
+        for (int y = 0; y < lines; y++) {
+            uint16_t *dst = out + y * out_stride + x0;
+            const uint8_t *py = &dec->planes[0][y * JPEG_PLANE_STRIDE];
+            if (dec->num_comps == 1) {
+                for (int x = 0; x < cols; x++) {
+                    put_pixel(&dst[x], py[x], 128, 128, swap_bytes);
+                }
+                continue;
+            }
+            const uint8_t *pcb = &dec->planes[1][(y >> vs) * JPEG_PLANE_STRIDE];
+            const uint8_t *pcr = &dec->planes[2][(y >> vs) * JPEG_PLANE_STRIDE];
+            for (int x = 0; x < cols; x++) {
+                put_pixel(&dst[x], py[x], pcb[x >> hs], pcr[x >> hs], swap_bytes);
+            }
+        }
+    }
+
+    dec->mcu_row++;
+    *ret_lines = lines;
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_jpeg_next_frame(const uint8_t *stream, size_t len, size_t *offset, const uint8_t **ret_frame, size_t *ret_frame_len)
+{
+    if (!stream || !offset || !ret_frame || !ret_frame_len) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t start = *offset;
+    while (start + 1 < len && !(stream[start] == 0xFF && stream[start + 1] == JPEG_MARKER_SOI)) {
+        start++;
+    }
+    if (start + 1 >= len) {
+        *offset = len;
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // walk the segments rather than searching for FFD9, an EXIF thumbnail carries its own EOI
+    size_t pos = start + 2;
+    while (pos + 1 < len) {
+        if (stream[pos] != 0xFF) {
+            // resume the search for the next SOI inside this frame
+            *offset = start + 2;
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        uint8_t marker = stream[pos + 1];
+        if (marker == 0xFF) {
+            pos++;
+            continue;
+        }
+        if (marker == JPEG_MARKER_EOI) {
+            *ret_frame = &stream[start];
+            *ret_frame_len = pos + 2 - start;
+            *offset = pos + 2;
+            return ESP_OK;
+        }
+        if (marker == JPEG_MARKER_TEM || (marker >= JPEG_MARKER_RST0 && marker <= JPEG_MARKER_RST7)) {
+            pos += 2;
+            continue;
+        }
+        if (pos + 4 > len) {
+            break;
+        }
+        pos += 2 + read_u16(&stream[pos + 2]);
+        if (marker == JPEG_MARKER_SOS) {
+            // entropy-coded data runs until a marker that is neither stuffing nor RSTn
+            while (pos + 1 < len && !(stream[pos] == 0xFF && stream[pos + 1] != 0x00 &&
+                                      !(stream[pos + 1] >= JPEG_MARKER_RST0 && stream[pos + 1] <= JPEG_MARKER_RST7))) {
+                pos++;
+            }
+        }
+    }
+    *offset = len;
+    return ESP_ERR_INVALID_RESPONSE;
+}
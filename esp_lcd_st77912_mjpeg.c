@@ -0,0 +1,383 @@
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
+#include "esp_bit_defs.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_lcd_panel_ops.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "esp_lcd_st77912_jpeg.h"
+#include "esp_lcd_st77912_mjpeg.h"
+
+#define MJPEG_BUF_NUM               (3)
+#define MJPEG_BUF_LINES             ST77912_JPEG_MAX_MCU_LINES
+#define MJPEG_RING_LEN              (MJPEG_BUF_NUM + 1)     // one spare slot tells a full ring from an empty one
+
+#define MJPEG_BAND_FIRST            BIT(0)
+#define MJPEG_BAND_LAST             BIT(1)
+#define MJPEG_BAND_DROPPED          BIT(2)
+#define MJPEG_BAND_END              BIT(3)  // end of clip, carries no pixels
+#define MJPEG_BAND_QUIT             BIT(4)
+#define MJPEG_BAND_CORRUPT          BIT(5)  // frame skipped after a parse/decode error, carries no pixels
+
+static const char *TAG = "st77912_mjpeg";
+
+typedef struct {
+    const uint8_t *clip;
+    size_t len;
+    bool quit;
+} mjpeg_play_req_t;
+
+typedef struct {
+    int8_t buf;
+    uint8_t flags;
+    uint16_t y_start;
+    uint16_t y_end;
+    uint16_t width;
+    st77912_mjpeg_frame_stats_t stats;
+} mjpeg_band_t;
+
+typedef struct st77912_mjpeg_player_t {
+    st77912_mjpeg_config_t config;
+    esp_lcd_panel_io_handle_t io;   // set once the callback is registered
+    st77912_jpeg_dec_t *dec;
+    uint16_t *bufs[MJPEG_BUF_NUM];
+    QueueHandle_t play_queue;
+    QueueHandle_t band_queue;
+    QueueHandle_t free_queue;
+    SemaphoreHandle_t frame_done;
+    SemaphoreHandle_t play_done;
+    TaskHandle_t decode_task;
+    TaskHandle_t transmit_task;
+    // bands handed to the bus, completed in order by mjpeg_color_trans_done()
+    struct {
+        int8_t buf;
+        bool last;
+    } inflight[MJPEG_RING_LEN];
+    volatile uint8_t inflight_head;
+    volatile uint8_t inflight_tail;
+    esp_err_t transmit_ret;
+    st77912_mjpeg_stats_t stats;    // only written by the decode task
+} st77912_mjpeg_player_t;
+
+static bool IRAM_ATTR mjpeg_color_trans_done(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
+{
+    st77912_mjpeg_player_t *player = (st77912_mjpeg_player_t *)user_ctx;
+    BaseType_t need_yield = pdFALSE;
+
+    if (player->inflight_tail == player->inflight_head) {
+        return false;
+    }
+    int8_t buf = player->inflight[player->inflight_tail].buf;
+    bool last = player->inflight[player->inflight_tail].last;
+    player->inflight_tail = (player->inflight_tail + 1) % MJPEG_RING_LEN;
+    xQueueSendFromISR(player->free_queue, &buf, &need_yield);
+    if (last) {
+        xSemaphoreGiveFromISR(player->frame_done, &need_yield);
+    }
+    return need_yield == pdTRUE;
+}
+
+static esp_err_t decode_frame(st77912_mjpeg_player_t *player, const uint8_t *frame, size_t frame_len, mjpeg_band_t *band)
+{
+    st77912_jpeg_dec_t *dec = player->dec;
+    uint32_t decode_us = 0;
+    int64_t start_us = esp_timer_get_time();
+
+    ESP_RETURN_ON_ERROR(esp_lcd_st77912_jpeg_start(dec, frame, frame_len), TAG, "parse frame %"PRIu32" failed", band->stats.frame);
+    ESP_RETURN_ON_FALSE(dec->width <= player->config.max_width, ESP_ERR_INVALID_SIZE, TAG, "frame wider than max_width");
+    decode_us += esp_timer_get_time() - start_us;
+
+    band->flags = MJPEG_BAND_FIRST;
+    band->width = dec->width;
+    for (int y = 0; y < dec->height;) {
+        int8_t buf = 0;
+        int lines = 0;
+        xQueueReceive(player->free_queue, &buf, portMAX_DELAY);
+
+        start_us = esp_timer_get_time();
+        esp_err_t ret = esp_lcd_st77912_jpeg_decode_rows(dec, player->bufs[buf], dec->width, player->config.flags.swap_bytes, &lines);
+        decode_us += esp_timer_get_time() - start_us;
+        if (ret != ESP_OK || !lines) {
+            xQueueSend(player->free_queue, &buf, portMAX_DELAY);
+            ESP_RETURN_ON_ERROR(ret == ESP_OK ? ESP_ERR_INVALID_RESPONSE : ret, TAG, "decode frame %"PRIu32" failed", band->stats.frame);
+        }
+
+        band->buf = buf;
+        band->y_start = y;
+        band->y_end = y + lines;
+        y += lines;
+        if (y >= dec->height) {
+            band->flags |= MJPEG_BAND_LAST;
+            band->stats.decode_us = decode_us;
+        }
+        xQueueSend(player->band_queue, band, portMAX_DELAY);
+        band->flags = 0;
+    }
+    return ESP_OK;
+}
+
+static void decode_clip(st77912_mjpeg_player_t *player, const uint8_t *clip, size_t len)
+{
+    int64_t period_us = 1000000 / player->config.fps;
+    int64_t start_us = esp_timer_get_time();
+    size_t offset = 0;
+    const uint8_t *frame = NULL;
+    size_t frame_len = 0;
+
+    for (uint32_t i = 0;; i++) {
+        esp_err_t ret = esp_lcd_st77912_jpeg_next_frame(clip, len, &offset, &frame, &frame_len);
+        if (ret == ESP_ERR_NOT_FOUND) {
+            break;
+        }
+        mjpeg_band_t band = {
+            .buf = -1,
+            .stats.frame = i,
+        };
+        player->stats.frames++;
+
+        if (ret == ESP_OK) {
+            int64_t due_us = start_us + i * period_us;
+            int64_t now_us = esp_timer_get_time();
+            if (now_us > due_us + period_us) {
+                // a full frame behind, skip this one without spending time on it
+                band.flags = MJPEG_BAND_DROPPED;
+                band.stats.dropped = true;
+                player->stats.dropped++;
+                xQueueSend(player->band_queue, &band, portMAX_DELAY);
+                continue;
+            }
+            if (now_us < due_us) {
+                vTaskDelay(pdMS_TO_TICKS((due_us - now_us) / 1000));
+                band.stats.idle_us = esp_timer_get_time() - now_us;
+            }
+            ret = decode_frame(player, frame, frame_len, &band);
+        }
+        if (ret != ESP_OK) {
+            // one broken frame in a clip shouldn't end playback, skip it and go on with the next
+            ESP_LOGW(TAG, "frame %"PRIu32" is corrupt (%s), skipped", i, esp_err_to_name(ret));
+            band.buf = -1;
+            band.flags = MJPEG_BAND_CORRUPT;
+            band.stats.corrupt = true;
+            player->stats.corrupt++;
+            xQueueSend(player->band_queue, &band, portMAX_DELAY);
+        }
+    }
+}
+
+static void mjpeg_decode_task(void *arg)
+{
+    st77912_mjpeg_player_t *player = (st77912_mjpeg_player_t *)arg;
+    mjpeg_play_req_t req;
+
+    while (xQueueReceive(player->play_queue, &req, portMAX_DELAY) == pdTRUE) {
+        mjpeg_band_t band = {
+            .buf = -1,
+            .flags = req.quit ? MJPEG_BAND_QUIT : MJPEG_BAND_END,
+        };
+        if (!req.quit) {
+            decode_clip(player, req.clip, req.len);
+        }
+        xQueueSend(player->band_queue, &band, portMAX_DELAY);
+        if (req.quit) {
+            break;
+        }
+    }
+    xSemaphoreGive(player->play_done);
+    vTaskDelete(NULL);
+}
+
+static void mjpeg_transmit_task(void *arg)
+{
+    st77912_mjpeg_player_t *player = (st77912_mjpeg_player_t *)arg;
+    const st77912_mjpeg_config_t *config = &player->config;
+    mjpeg_band_t band;
+    int64_t first_us = 0;
+    bool failed = false;
+
+    while (xQueueReceive(player->band_queue, &band, portMAX_DELAY) == pdTRUE) {
+        if (band.flags & MJPEG_BAND_QUIT) {
+            break;
+        }
+        if (band.flags & MJPEG_BAND_END) {
+            xSemaphoreGive(player->play_done);
+            continue;
+        }
+        if (band.flags & (MJPEG_BAND_DROPPED | MJPEG_BAND_CORRUPT)) {
+            if (config->on_frame) {
+                config->on_frame(&band.stats, config->user_ctx);
+            }
+            continue;
+        }
+        if (band.flags & MJPEG_BAND_FIRST) {
+            first_us = esp_timer_get_time();
+            failed = false;
+        }
+
+        // queue the completion slot before the transfer, it can finish before draw_bitmap returns.
+        // Only this task moves the head, the ISR only moves the tail
+        bool last = band.flags & MJPEG_BAND_LAST;
+        uint8_t head = player->inflight_head;
+        player->inflight[head].buf = band.buf;
+        player->inflight[head].last = last;
+        player->inflight_head = (head + 1) % MJPEG_RING_LEN;
+
+        esp_err_t ret = esp_lcd_panel_draw_bitmap(config->panel, config->x, config->y + band.y_start,
+                                                  config->x + band.width, config->y + band.y_end, player->bufs[band.buf]);
+        if (ret != ESP_OK) {
+            // nothing reached the bus, so no completion will claim the slot
+            player->inflight_head = head;
+            xQueueSend(player->free_queue, &band.buf, portMAX_DELAY);
+            player->transmit_ret = ret;
+            failed = true;
+            ESP_LOGE(TAG, "send band of frame %"PRIu32" failed", band.stats.frame);
+        } else if (last) {
+            xSemaphoreTake(player->frame_done, portMAX_DELAY);
+        }
+        if (last) {
+            // reported even when the last band failed, on_frame fires once for every frame
+            band.stats.transmit_us = esp_timer_get_time() - first_us;
+            band.stats.failed = failed;
+            if (config->on_frame) {
+                config->on_frame(&band.stats, config->user_ctx);
+            }
+        }
+    }
+    xSemaphoreGive(player->play_done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t esp_lcd_st77912_mjpeg_new(const st77912_mjpeg_config_t *config, st77912_mjpeg_handle_t *ret_player)
+{
+    ESP_RETURN_ON_FALSE(config && ret_player && config->panel && config->io, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(config->max_width > 0 && config->fps > 0 && config->task_stack, ESP_ERR_INVALID_ARG, TAG, "invalid config");
+
+    esp_err_t ret = ESP_OK;
+    st77912_mjpeg_player_t *player = calloc(1, sizeof(st77912_mjpeg_player_t));
+    ESP_GOTO_ON_FALSE(player, ESP_ERR_NO_MEM, err, TAG, "no mem for player");
+    player->config = *config;
+
+    player->dec = calloc(1, sizeof(st77912_jpeg_dec_t));
+    ESP_GOTO_ON_FALSE(player->dec, ESP_ERR_NO_MEM, err, TAG, "no mem for decoder");
+    player->play_queue = xQueueCreate(1, sizeof(mjpeg_play_req_t));
+    player->band_queue = xQueueCreate(MJPEG_BUF_NUM + 1, sizeof(mjpeg_band_t));
+    player->free_queue = xQueueCreate(MJPEG_BUF_NUM, sizeof(int8_t));
+    player->frame_done = xSemaphoreCreateBinary();
+    player->play_done = xSemaphoreCreateCounting(2, 0);
+    ESP_GOTO_ON_FALSE(player->play_queue && player->band_queue && player->free_queue && player->frame_done && player->play_done,
+                      ESP_ERR_NO_MEM, err, TAG, "no mem for player queues");
+    for (int8_t i = 0; i < MJPEG_BUF_NUM; i++) {
+        player->bufs[i] = heap_caps_malloc(config->max_width * MJPEG_BUF_LINES * sizeof(uint16_t), MALLOC_CAP_DMA);
+        ESP_GOTO_ON_FALSE(player->bufs[i], ESP_ERR_NO_MEM, err, TAG, "no mem for band buffer");
+        xQueueSend(player->free_queue, &i, 0);
+    }
+
+    const esp_lcd_panel_io_callbacks_t cbs = {
+        .on_color_trans_done = mjpeg_color_trans_done,
+    };
+    ESP_GOTO_ON_ERROR(esp_lcd_panel_io_register_event_callbacks(config->io, &cbs, player), err, TAG, "register IO callback failed");
+    player->io = config->io;
+
+    ESP_GOTO_ON_FALSE(xTaskCreatePinnedToCore(mjpeg_transmit_task, "mjpeg_tx", config->task_stack, player,
+                                              config->task_priority, &player->transmit_task, config->transmit_core) == pdPASS,
+                      ESP_ERR_NO_MEM, err, TAG, "create transmit task failed");
+    if (xTaskCreatePinnedToCore(mjpeg_decode_task, "mjpeg_dec", config->task_stack, player,
+                                config->task_priority, &player->decode_task, config->decode_core) != pdPASS) {
+        mjpeg_band_t band = {
+            .buf = -1,
+            .flags = MJPEG_BAND_QUIT,
+        };
+        xQueueSend(player->band_queue, &band, portMAX_DELAY);
+        xSemaphoreTake(player->play_done, portMAX_DELAY);
+        player->transmit_task = NULL;
+        ESP_GOTO_ON_FALSE(false, ESP_ERR_NO_MEM, err, TAG, "create decode task failed");
+    }
+
+    *ret_player = player;
+    ESP_LOGD(TAG, "new mjpeg player @%p", player);
+    return ESP_OK;
+
+err:
+    if (player) {
+        esp_lcd_st77912_mjpeg_del(player);
+    }
+    return ret;
+}
+
+esp_err_t esp_lcd_st77912_mjpeg_play(st77912_mjpeg_handle_t player, const uint8_t *clip, size_t len)
+{
+    ESP_RETURN_ON_FALSE(player && clip && len, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    mjpeg_play_req_t req = {
+        .clip = clip,
+        .len = len,
+    };
+    player->transmit_ret = ESP_OK;
+    xQueueSend(player->play_queue, &req, portMAX_DELAY);
+    xSemaphoreTake(player->play_done, portMAX_DELAY);
+
+    ESP_RETURN_ON_ERROR(player->transmit_ret, TAG, "transmit failed");
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_mjpeg_get_stats(st77912_mjpeg_handle_t player, st77912_mjpeg_stats_t *ret_stats)
+{
+    ESP_RETURN_ON_FALSE(player && ret_stats, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    *ret_stats = player->stats;
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_st77912_mjpeg_del(st77912_mjpeg_handle_t player)
+{
+    ESP_RETURN_ON_FALSE(player, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    if (player->decode_task) {
+        // the decode task forwards the quit to the transmit task, both signal play_done on the way out
+        mjpeg_play_req_t req = {
+            .quit = true,
+        };
+        xQueueSend(player->play_queue, &req, portMAX_DELAY);
+        xSemaphoreTake(player->play_done, portMAX_DELAY);
+        xSemaphoreTake(player->play_done, portMAX_DELAY);
+    }
+    // wait for bands still on the bus
+    for (int i = 0; player->free_queue && i < MJPEG_BUF_NUM && player->bufs[i]; i++) {
+        int8_t buf;
+        xQueueReceive(player->free_queue, &buf, portMAX_DELAY);
+    }
+    if (player->io) {
+        // later transfers on the IO must not call back into freed memory
+        esp_lcd_panel_io_register_event_callbacks(player->io, &(esp_lcd_panel_io_callbacks_t) {
+            0
+        }, NULL);
+    }
+    for (int i = 0; i < MJPEG_BUF_NUM; i++) {
+        free(player->bufs[i]);
+    }
+    if (player->play_queue) {
+        vQueueDelete(player->play_queue);
+    }
+    if (player->band_queue) {
+        vQueueDelete(player->band_queue);
+    }
+    if (player->free_queue) {
+        vQueueDelete(player->free_queue);
+    }
+    if (player->frame_done) {
+        vSemaphoreDelete(player->frame_done);
+    }
+    if (player->play_done) {
+        vSemaphoreDelete(player->play_done);
+    }
+    free(player->dec);
+    free(player);
+    return ESP_OK;
+}
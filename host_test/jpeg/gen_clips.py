@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+"""Regenerate the sample frames and their reference pixels for test_jpeg/test_mjpeg.
+
+Every sampling the decoder supports, at a size that isn't a multiple of the MCU. The reference is Pillow's
+(libjpeg's) decode as raw RGB888. Chroma only changes smoothly and the sharp edges are in luma only, so libjpeg's
+interpolating chroma upsampling and the decoder's replication agree to within rounding.
+
+    python3 gen_clips.py        # writes <name>.jpg and <name>.rgb next to this script
+"""
+
+import math
+import os
+
+from PIL import Image
+
+WIDTH = 61
+HEIGHT = 45
+
+# name: (mode, Pillow subsampling, restart interval in MCU rows)
+FRAMES = {
+    'yuv420': ('RGB', 2, 1),
+    'yuv422': ('RGB', 1, 0),
+    'yuv444': ('RGB', 0, 0),
+    'grey': ('L', 0, 0),
+}
+
+
+def make_image(mode):
+    img = Image.new('RGB', (WIDTH, HEIGHT))
+    px = img.load()
+    for y in range(HEIGHT):
+        for x in range(WIDTH):
+            r = 128 + 90 * math.sin(x / 11.0)
+            g = 128 + 90 * math.cos(y / 9.0)
+            b = 128 + 90 * math.sin((x + y) / 13.0)
+            if 20 <= x < 34 and 12 <= y < 30:
+                # sharp edges, but only in luma: the same offset on every channel leaves Cb/Cr alone
+                d = 35 if (x // 3 + y // 3) % 2 else -35
+                r, g, b = r + d, g + d, b + d
+            px[x, y] = (int(r), int(g), int(b))
+    return img.convert(mode)
+
+
+def main():
+    out_dir = os.path.dirname(os.path.abspath(__file__))
+    for name, (mode, subsampling, restart_rows) in FRAMES.items():
+        path = os.path.join(out_dir, name + '.jpg')
+        kwargs = {'quality': 92, 'subsampling': subsampling, 'optimize': False}
+        if restart_rows:
+            kwargs['restart_marker_rows'] = restart_rows
+        make_image(mode).save(path, 'JPEG', **kwargs)
+        with Image.open(path) as decoded:
+            with open(os.path.join(out_dir, name + '.rgb'), 'wb') as f:
+                f.write(decoded.convert('RGB').tobytes())
+        print('%s: %d bytes' % (path, os.path.getsize(path)))
+
+
+if __name__ == '__main__':
+    main()
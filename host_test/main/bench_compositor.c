@@ -0,0 +1,108 @@
+#include <malloc.h>
+#include <stdio.h>
+#include <sys/param.h>
+
+#include "esp_lcd_panel_ops.h"
+#include "esp_timer.h"
+#include "mock_lcd_panel.h"
+#include "test_utils.h"
+
+#include "esp_lcd_st77912.h"
+#include "esp_lcd_st77912_compositor.h"
+
+// heap used by the compositor and the blend rate of full-screen flushes, the numbers quoted in the README:
+//   ./bench_compositor [h_res v_res band_lines]
+// the IO has no panel behind it, so only blending and the driver's own work are measured
+
+#define BENCH_FLUSHES               (200)
+
+static uint16_t *s_bg;
+static uint16_t s_toast[100 * 40];
+
+static void bench(esp_lcd_panel_handle_t panel, esp_lcd_panel_io_handle_t io, int h_res, int v_res, int band_lines)
+{
+    st77912_compositor_config_t comp_config = {
+        .panel = panel,
+        .io = io,
+        .h_res = h_res,
+        .v_res = v_res,
+        .band_lines = band_lines,
+        .max_layers = 2,
+    };
+    size_t heap_before = mallinfo2().uordblks;
+    st77912_compositor_handle_t comp = NULL;
+    TEST_ESP_OK(esp_lcd_st77912_compositor_new(&comp_config, &comp));
+    size_t heap_used = mallinfo2().uordblks - heap_before;
+
+    st77912_layer_config_t bg = {
+        .width = h_res,
+        .height = v_res,
+        .pixels = s_bg,
+        .alpha = 255,
+        .flags.visible = true,
+    };
+    st77912_layer_config_t toast = {
+        .x = (h_res - 100) / 2,
+        .y = v_res - 60,
+        .width = 100,
+        .height = 40,
+        .pixels = s_toast,
+        .alpha = 160,
+        .flags.visible = true,
+    };
+    int bg_layer, toast_layer;
+    TEST_ESP_OK(esp_lcd_st77912_compositor_add_layer(comp, &bg, &bg_layer));
+    TEST_ESP_OK(esp_lcd_st77912_compositor_add_layer(comp, &toast, &toast_layer));
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < BENCH_FLUSHES; i++) {
+        TEST_ESP_OK(esp_lcd_st77912_compositor_invalidate(comp, bg_layer, 0, 0, h_res, v_res));
+        TEST_ESP_OK(esp_lcd_st77912_compositor_flush(comp));
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start;
+
+    st77912_compositor_stats_t stats;
+    TEST_ESP_OK(esp_lcd_st77912_compositor_get_stats(comp, &stats));
+    TEST_ASSERT_EQUAL((uint64_t)BENCH_FLUSHES * h_res * v_res, stats.sent_bytes / 2);
+    printf("%dx%d band_lines=%-3d heap %7zu B (one frame %7zu B)  compose %6.1f Mpix/s  flush %5.2f ms/frame\n",
+           h_res, v_res, band_lines, heap_used, (size_t)h_res * v_res * sizeof(uint16_t),
+           (double)stats.composed_pixels / MAX(stats.compose_us, 1), elapsed_us / 1000.0 / BENCH_FLUSHES);
+    TEST_ESP_OK(esp_lcd_st77912_compositor_del(comp));
+}
+
+int main(int argc, char **argv)
+{
+    int h_res = argc > 3 ? atoi(argv[1]) : 240;
+    int v_res = argc > 3 ? atoi(argv[2]) : 240;
+    int band_lines = argc > 3 ? atoi(argv[3]) : 20;
+
+    s_bg = malloc(h_res * v_res * sizeof(uint16_t));
+    TEST_ASSERT_TRUE(s_bg);
+    for (int i = 0; i < h_res * v_res; i++) {
+        s_bg[i] = (uint16_t)(i * 31);
+    }
+    for (size_t i = 0; i < sizeof(s_toast) / sizeof(s_toast[0]); i++) {
+        s_toast[i] = 0xFFFF;
+    }
+
+    mock_lcd_io_config_t io_config = {
+        .pclk_hz = 80 * 1000 * 1000,
+    };
+    esp_lcd_panel_io_handle_t io = NULL;
+    TEST_ESP_OK(mock_lcd_io_new(NULL, &io_config, &io));
+    esp_lcd_panel_dev_config_t panel_config = {
+        .reset_gpio_num = -1,
+        .bits_per_pixel = 16,
+    };
+    esp_lcd_panel_handle_t panel = NULL;
+    TEST_ESP_OK(esp_lcd_new_panel_st77912(io, &panel_config, &panel));
+
+    bench(panel, io, h_res, v_res, band_lines);
+    // whole-frame bands for comparison: same blending, two frame-sized buffers
+    bench(panel, io, h_res, v_res, v_res);
+
+    TEST_ESP_OK(esp_lcd_panel_del(panel));
+    TEST_ESP_OK(esp_lcd_panel_io_del(io));
+    free(s_bg);
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_lcd_panel_io_interface.h"
+#include "esp_lcd_panel_ops.h"
+#include "esp_timer.h"
+#include "test_utils.h"
+
+#include "esp_lcd_st77912.hpp"
+
+// cost per call of Panel::draw() against esp_lcd_panel_draw_bitmap(), the numbers quoted in the README:
+//   ./bench_cpp [calls]
+// both send the same small window to an IO that only counts what it gets, so the time is the work in front of
+// the bus: the function table and checks of the C path against the C++ path's precomputed window bytes
+
+using Lcd = esp_lcd_st77912::Panel<240, 240>;
+
+#define BENCH_W                     (16)
+#define BENCH_H                     (16)
+
+typedef struct {
+    esp_lcd_panel_io_t base;
+    uint64_t params;
+    uint64_t colors;
+    uint64_t color_bytes;
+    uint32_t window_sum;        // keeps the parameter bytes live
+} null_io_t;
+
+static esp_err_t null_rx_param(esp_lcd_panel_io_t *io, int lcd_cmd, void *param, size_t param_size)
+{
+    memset(param, 0, param_size);
+    return ESP_OK;
+}
+
+static esp_err_t null_tx_param(esp_lcd_panel_io_t *io, int lcd_cmd, const void *param, size_t param_size)
+{
+    null_io_t *nio = __containerof(io, null_io_t, base);
+    nio->params++;
+    for (size_t i = 0; i < param_size; i++) {
+        nio->window_sum += static_cast<const uint8_t *>(param)[i];
+    }
+    return ESP_OK;
+}
+
+static esp_err_t null_tx_color(esp_lcd_panel_io_t *io, int lcd_cmd, const void *color, size_t color_size)
+{
+    null_io_t *nio = __containerof(io, null_io_t, base);
+    nio->colors++;
+    nio->color_bytes += color_size;
+    return ESP_OK;
+}
+
+static esp_err_t null_register_event_callbacks(esp_lcd_panel_io_t *io, const esp_lcd_panel_io_callbacks_t *cbs, void *user_ctx)
+{
+    return ESP_OK;
+}
+
+static uint16_t s_pixels[BENCH_W * BENCH_H];
+
+static double bench_c(esp_lcd_panel_handle_t panel, int calls)
+{
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < calls; i++) {
+        int x = (i * BENCH_W) % (Lcd::h_res - BENCH_W);
+        TEST_ESP_OK(esp_lcd_panel_draw_bitmap(panel, x, 0, x + BENCH_W, BENCH_H, s_pixels));
+    }
+    return (esp_timer_get_time() - start) * 1000.0 / calls;
+}
+
+static double bench_cpp(const Lcd &lcd, int calls)
+{
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < calls; i++) {
+        int x = (i * BENCH_W) % (Lcd::h_res - BENCH_W);
+        TEST_ESP_OK(lcd.draw(x, 0, x + BENCH_W, BENCH_H, s_pixels));
+    }
+    return (esp_timer_get_time() - start) * 1000.0 / calls;
+}
+
+int main(int argc, char **argv)
+{
+    int calls = argc > 1 ? atoi(argv[1]) : 2000000;
+
+    static null_io_t nio;
+    nio.base.rx_param = null_rx_param;
+    nio.base.tx_param = null_tx_param;
+    nio.base.tx_color = null_tx_color;
+    nio.base.register_event_callbacks = null_register_event_callbacks;
+    {
+        Lcd lcd;
+        TEST_ESP_OK(Lcd::create(&nio.base, -1, &lcd));
+        // warm up, then the same traffic from both paths
+        bench_c(lcd.handle(), calls / 10);
+        bench_cpp(lcd, calls / 10);
+
+        null_io_t before = nio;
+        double c_ns = bench_c(lcd.handle(), calls);
+        null_io_t after_c = nio;
+        double cpp_ns = bench_cpp(lcd, calls);
+        TEST_ASSERT_EQUAL(after_c.params - before.params, nio.params - after_c.params);
+        TEST_ASSERT_EQUAL(after_c.colors - before.colors, nio.colors - after_c.colors);
+        TEST_ASSERT_EQUAL(after_c.color_bytes - before.color_bytes, nio.color_bytes - after_c.color_bytes);
+        TEST_ASSERT_EQUAL(after_c.window_sum - before.window_sum, nio.window_sum - after_c.window_sum);
+
+        printf("%dx%d window, %d calls: draw_bitmap %5.1f ns/call  Panel::draw %5.1f ns/call  (%.1fx)\n",
+               BENCH_W, BENCH_H, calls, c_ns, cpp_ns, c_ns / cpp_ns);
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "esp_timer.h"
+#include "mock_lcd_panel.h"
+#include "nvs.h"
+#include "test_utils.h"
+
+#include "esp_lcd_st77912.h"
+
+#define TEST_BUS                    (1)
+
+static mock_lcd_panel_t *s_mock;
+
+static void setup(uint32_t max_write_hz, uint32_t max_read_hz, bool no_readback)
+{
+    mock_lcd_panel_config_t mock_config = {
+        .width = 240,
+        .height = 240,
+        .max_write_hz = max_write_hz,
+        .max_read_hz = max_read_hz,
+        .no_readback = no_readback,
+    };
+    TEST_ESP_OK(mock_lcd_panel_new(&mock_config, &s_mock));
+    mock_lcd_panel_attach_bus(TEST_BUS, s_mock);
+    host_nvs_reset();
+}
+
+static esp_err_t calibrate(uint8_t bits_per_pixel, uint32_t *ret_pclk_hz)
+{
+    esp_lcd_panel_io_spi_config_t io_config = ST77912_PANEL_IO_SPI_CONFIG(10, 11, NULL, NULL);
+    esp_lcd_panel_dev_config_t panel_config = {
+        .reset_gpio_num = 9,
+        .bits_per_pixel = bits_per_pixel,
+    };
+    st77912_pclk_calib_config_t calib_config = ST77912_PCLK_CALIB_DEFAULT_CONFIG();
+    return esp_lcd_st77912_calibrate_pclk(TEST_BUS, &io_config, &panel_config, &calib_config, ret_pclk_hz);
+}
+
+static void test_calibrate(void)
+{
+    // writes break above 40 MHz, reads above 10 MHz: only the write limit may count
+    setup(40 * 1000 * 1000, 10 * 1000 * 1000, false);
+    uint32_t pclk_hz = 0;
+    TEST_ESP_OK(calibrate(16, &pclk_hz));
+    // 40 MHz (80 / 2) is the last stable divider, 15% off is 34 MHz, the next clock the bus can run at below is 80 / 3
+    TEST_ASSERT_EQUAL(80 * 1000 * 1000 / 3, pclk_hz);
+
+    uint32_t loaded_hz = 0;
+    TEST_ESP_OK(esp_lcd_st77912_load_pclk("st77912", &loaded_hz));
+    TEST_ASSERT_EQUAL(pclk_hz, loaded_hz);
+    mock_lcd_panel_del(s_mock);
+
+    // a write limit between dividers: 20 MHz (80 / 4) passes, 26.7 MHz doesn't, 17 MHz is rounded down to 16 MHz
+    setup(24 * 1000 * 1000, 10 * 1000 * 1000, false);
+    TEST_ESP_OK(calibrate(18, &pclk_hz));
+    TEST_ASSERT_EQUAL(16 * 1000 * 1000, pclk_hz);
+    mock_lcd_panel_del(s_mock);
+
+    // nothing above the start clock works, the margin must not push below it
+    setup(10 * 1000 * 1000, 0, false);
+    TEST_ESP_OK(calibrate(16, &pclk_hz));
+    TEST_ASSERT_EQUAL(10 * 1000 * 1000, pclk_hz);
+    mock_lcd_panel_del(s_mock);
+}
+
+static void test_calibrate_no_readback(void)
+{
+    setup(0, 0, true);
+    uint32_t pclk_hz = 0;
+    TEST_ESP_ERR(ESP_ERR_NOT_SUPPORTED, calibrate(16, &pclk_hz));
+    TEST_ASSERT_EQUAL(0, pclk_hz);
+    mock_lcd_panel_del(s_mock);
+}
+
+static void test_calibrate_nvs_failure(void)
+{
+    setup(40 * 1000 * 1000, 0, false);
+    uint32_t pclk_hz = 0;
+    // the first NVS call is the open after probing
+    host_nvs_fail_next(ESP_ERR_NVS_NOT_INITIALIZED);
+    TEST_ESP_ERR(ESP_ERR_NVS_NOT_INITIALIZED, calibrate(16, &pclk_hz));
+    TEST_ASSERT_EQUAL(80 * 1000 * 1000 / 3, pclk_hz);
+    mock_lcd_panel_del(s_mock);
+}
+
+static void test_load_pclk(void)
+{
+    host_nvs_reset();
+    uint32_t pclk_hz = 1234;
+    TEST_ESP_ERR(ESP_ERR_NOT_FOUND, esp_lcd_st77912_load_pclk("st77912", &pclk_hz));
+    TEST_ASSERT_EQUAL(1234, pclk_hz);
+
+    // namespace exists, key doesn't
+    nvs_handle_t nvs;
+    TEST_ESP_OK(nvs_open("st77912", NVS_READWRITE, &nvs));
+    TEST_ESP_OK(nvs_set_u32(nvs, "other", 1));
+    nvs_close(nvs);
+    TEST_ESP_ERR(ESP_ERR_NOT_FOUND, esp_lcd_st77912_load_pclk("st77912", &pclk_hz));
+
+    host_nvs_fail_next(ESP_ERR_NVS_NOT_INITIALIZED);
+    TEST_ESP_ERR(ESP_ERR_NVS_NOT_INITIALIZED, esp_lcd_st77912_load_pclk("st77912", &pclk_hz));
+    TEST_ASSERT_EQUAL(1234, pclk_hz);
+}
+
+int main(void)
+{
+    host_clock_set_virtual(true);
+    RUN_TEST(test_calibrate);
+    RUN_TEST(test_calibrate_no_readback);
+    RUN_TEST(test_calibrate_nvs_failure);
+    RUN_TEST(test_load_pclk);
+    return 0;
+}
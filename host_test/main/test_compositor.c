@@ -0,0 +1,331 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "esp_lcd_panel_commands.h"
+#include "esp_lcd_panel_ops.h"
+#include "esp_timer.h"
+#include "mock_lcd_panel.h"
+#include "test_fixture.h"
+#include "test_utils.h"
+
+#include "esp_lcd_st77912.h"
+#include "esp_lcd_st77912_compositor.h"
+
+#define TEST_BAND_LINES             (20)
+#define TEST_BG_COLOR               (0x001F)
+#define TEST_KEY_COLOR              (0x07E0)
+
+static test_fixture_t s_fx;
+static st77912_compositor_handle_t s_comp;
+static atomic_bool s_del_done;
+static bool s_swap;
+
+static void setup_swap(bool swap)
+{
+    test_fixture_setup(&(test_fixture_config_t) {
+        .async = true,
+    }, &s_fx);
+    s_swap = swap;
+    st77912_compositor_config_t comp_config = {
+        .panel = s_fx.panel,
+        .io = s_fx.io,
+        .h_res = TEST_H_RES,
+        .v_res = TEST_V_RES,
+        .band_lines = TEST_BAND_LINES,
+        .max_layers = 3,
+        .bg_color = swap ? __builtin_bswap16(TEST_BG_COLOR) : TEST_BG_COLOR,
+        .flags.swap_bytes = swap,
+    };
+    TEST_ESP_OK(esp_lcd_st77912_compositor_new(&comp_config, &s_comp));
+}
+
+static void setup(void)
+{
+    setup_swap(true);
+}
+
+// an RGB565 color as the compositor stores it
+static uint16_t stored(uint16_t color)
+{
+    return s_swap ? __builtin_bswap16(color) : color;
+}
+
+// what the mock panel holds after the compositor sent color: the bytes go out as stored, so unswapped pixels
+// arrive byte-swapped
+static uint32_t sent(uint16_t color)
+{
+    uint16_t v = s_swap ? color : __builtin_bswap16(color);
+    uint32_t r = (v >> 11) & 0x1F;
+    uint32_t g = (v >> 5) & 0x3F;
+    uint32_t b = v & 0x1F;
+    return (((r << 1) | (r >> 4)) << 18) | (g << 10) | (((b << 1) | (b >> 4)) << 2);
+}
+
+static void fill(uint16_t *pixels, size_t num, uint16_t color)
+{
+    for (size_t i = 0; i < num; i++) {
+        pixels[i] = stored(color);
+    }
+}
+
+static void flush_and_wait(void)
+{
+    TEST_ESP_OK(esp_lcd_st77912_compositor_flush(s_comp));
+    mock_lcd_io_wait_idle(s_fx.io);
+}
+
+static void teardown(void)
+{
+    TEST_ESP_OK(esp_lcd_st77912_compositor_del(s_comp));
+    test_fixture_teardown(&s_fx);
+}
+
+static void *del_task(void *arg)
+{
+    TEST_ESP_OK(esp_lcd_st77912_compositor_del(s_comp));
+    atomic_store(&s_del_done, true);
+    return NULL;
+}
+
+// flush with the last band held on the bus, then delete from another thread while the band is still out
+static void flush_and_del(int foreign_transfers)
+{
+    static uint16_t toast[40 * 40];
+    for (size_t i = 0; i < sizeof(toast) / sizeof(toast[0]); i++) {
+        toast[i] = __builtin_bswap16(0xF800);
+    }
+    st77912_layer_config_t layer = {
+        .x = 100,
+        .y = 100,
+        .width = 40,
+        .height = 40,
+        .pixels = toast,
+        .alpha = 255,
+        .flags.visible = true,
+    };
+    int layer_id;
+    TEST_ESP_OK(esp_lcd_st77912_compositor_add_layer(s_comp, &layer, &layer_id));
+
+    mock_lcd_io_hold(s_fx.io, true);
+    TEST_ESP_OK(esp_lcd_st77912_compositor_flush(s_comp));
+    // pixels sent around the compositor, queued behind its last band
+    static uint16_t line[TEST_H_RES];
+    for (int i = 0; i < foreign_transfers; i++) {
+        TEST_ESP_OK(esp_lcd_panel_io_tx_color(s_fx.io, LCD_CMD_RAMWRC, line, sizeof(line)));
+    }
+    TEST_ASSERT_EQUAL(1 + foreign_transfers, mock_lcd_io_inflight(s_fx.io));
+
+    pthread_t thread;
+    atomic_store(&s_del_done, false);
+    pthread_create(&thread, NULL, del_task, NULL);
+    usleep(50 * 1000);
+    TEST_ASSERT_FALSE(atomic_load(&s_del_done));
+    mock_lcd_io_hold(s_fx.io, false);
+    pthread_join(thread, NULL);
+    TEST_ASSERT_TRUE(atomic_load(&s_del_done));
+    mock_lcd_io_wait_idle(s_fx.io);
+
+    mock_lcd_io_stats_t stats;
+    mock_lcd_io_get_stats(s_fx.io, &stats);
+    TEST_ASSERT_EQUAL(0, stats.inflight_modified);
+    TEST_ASSERT_EQUAL(TEST_V_RES / TEST_BAND_LINES + foreign_transfers, stats.completions);
+    TEST_ASSERT_EQUAL(0xFC0000, mock_lcd_panel_get_pixel(s_fx.mock, 120, 120));
+    TEST_ASSERT_EQUAL(0x0000FC, mock_lcd_panel_get_pixel(s_fx.mock, 10, 10));
+
+    // the IO outlives the compositor, its callback must be gone (ASan flags the use after free otherwise)
+    mock_lcd_io_foreign_done(s_fx.io);
+    TEST_ESP_OK(esp_lcd_panel_draw_bitmap(s_fx.panel, 0, 0, TEST_H_RES, 1, line));
+    mock_lcd_io_wait_idle(s_fx.io);
+}
+
+static void test_del_waits_for_bands(void)
+{
+    setup();
+    flush_and_del(0);
+    test_fixture_teardown(&s_fx);
+}
+
+static void test_foreign_completions(void)
+{
+    setup();
+    flush_and_del(3);
+    test_fixture_teardown(&s_fx);
+}
+
+static void test_foreign_transfer_before_flush(void)
+{
+    setup();
+    // a direct draw still on the bus when the flush starts: its completion must not be counted as a band
+    static uint16_t line[TEST_H_RES];
+    mock_lcd_io_hold(s_fx.io, true);
+    TEST_ESP_OK(esp_lcd_panel_draw_bitmap(s_fx.panel, 0, 0, TEST_H_RES, 1, line));
+    TEST_ESP_OK(esp_lcd_st77912_compositor_flush(s_comp));
+    TEST_ASSERT_EQUAL(1, mock_lcd_io_inflight(s_fx.io));
+
+    pthread_t thread;
+    atomic_store(&s_del_done, false);
+    pthread_create(&thread, NULL, del_task, NULL);
+    usleep(50 * 1000);
+    TEST_ASSERT_FALSE(atomic_load(&s_del_done));
+    mock_lcd_io_hold(s_fx.io, false);
+    pthread_join(thread, NULL);
+    mock_lcd_io_stats_t stats;
+    mock_lcd_io_get_stats(s_fx.io, &stats);
+    TEST_ASSERT_EQUAL(0, stats.inflight_modified);
+    test_fixture_teardown(&s_fx);
+}
+
+static void alpha_over_bg(bool swap)
+{
+    setup_swap(swap);
+    static uint16_t white[40 * 40];
+    fill(white, 40 * 40, 0xFFFF);
+    st77912_layer_config_t layer = {
+        .x = 100,
+        .y = 100,
+        .width = 40,
+        .height = 40,
+        .pixels = white,
+        .alpha = 128,
+        .flags.visible = true,
+    };
+    int layer_id;
+    TEST_ESP_OK(esp_lcd_st77912_compositor_add_layer(s_comp, &layer, &layer_id));
+    flush_and_wait();
+
+    // half of white over blue: red 31 -> 15, green 63 -> 31, blue stays
+    TEST_ASSERT_EQUAL(sent(0x7BFF), mock_lcd_panel_get_pixel(s_fx.mock, 100, 100));
+    TEST_ASSERT_EQUAL(sent(0x7BFF), mock_lcd_panel_get_pixel(s_fx.mock, 139, 139));
+    TEST_ASSERT_EQUAL(sent(TEST_BG_COLOR), mock_lcd_panel_get_pixel(s_fx.mock, 99, 100));
+    TEST_ASSERT_EQUAL(sent(TEST_BG_COLOR), mock_lcd_panel_get_pixel(s_fx.mock, 140, 139));
+    teardown();
+}
+
+static void test_alpha_swapped(void)
+{
+    alpha_over_bg(true);
+}
+
+static void test_alpha_native(void)
+{
+    alpha_over_bg(false);
+}
+
+#define TEST_KEY_W                  (41)
+#define TEST_KEY_H                  (4)
+
+// runs of two keyed and three red pixels, so 32-bit pairs are all keyed, none keyed or mixed either way
+static bool keyed(int i)
+{
+    return i % 5 < 2;
+}
+
+static void test_color_key(void)
+{
+    setup();
+    // even x with aligned pixels takes the pair loop, odd x with pixels one off takes the head pixel first and
+    // odd x with aligned pixels is scalar throughout; the odd width leaves a tail in each
+    static uint16_t aligned_px[TEST_KEY_W * TEST_KEY_H] __attribute__((aligned(4)));
+    static uint16_t offset_px[TEST_KEY_W * TEST_KEY_H + 1] __attribute__((aligned(4)));
+    for (int i = 0; i < TEST_KEY_W * TEST_KEY_H; i++) {
+        aligned_px[i] = stored(keyed(i % TEST_KEY_W) ? TEST_KEY_COLOR : 0xF800);
+        offset_px[i + 1] = aligned_px[i];
+    }
+    const struct {
+        int x;
+        int y;
+        const uint16_t *pixels;
+    } cases[] = {
+        {100, 20, aligned_px},
+        {101, 60, offset_px + 1},
+        {101, 100, aligned_px},
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        st77912_layer_config_t layer = {
+            .x = cases[c].x,
+            .y = cases[c].y,
+            .width = TEST_KEY_W,
+            .height = TEST_KEY_H,
+            .pixels = cases[c].pixels,
+            .alpha = 255,
+            .color_key = stored(TEST_KEY_COLOR),
+            .flags = {
+                .visible = true,
+                .use_color_key = true,
+            },
+        };
+        int layer_id;
+        TEST_ESP_OK(esp_lcd_st77912_compositor_add_layer(s_comp, &layer, &layer_id));
+    }
+    flush_and_wait();
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        for (int y = 0; y < TEST_KEY_H; y++) {
+            for (int x = 0; x < TEST_KEY_W; x++) {
+                uint32_t expected = keyed(x) ? sent(TEST_BG_COLOR) : sent(0xF800);
+                TEST_ASSERT_EQUAL(expected, mock_lcd_panel_get_pixel(s_fx.mock, cases[c].x + x, cases[c].y + y));
+            }
+        }
+    }
+    teardown();
+}
+
+static void test_invalidate_sends_window(void)
+{
+    setup();
+    static uint16_t toast[40 * 40];
+    fill(toast, 40 * 40, 0xF800);
+    st77912_layer_config_t layer = {
+        .x = 100,
+        .y = 100,
+        .width = 40,
+        .height = 40,
+        .pixels = toast,
+        .alpha = 255,
+        .flags.visible = true,
+    };
+    int layer_id;
+    TEST_ESP_OK(esp_lcd_st77912_compositor_add_layer(s_comp, &layer, &layer_id));
+    flush_and_wait();
+
+    // the whole layer changes, but only two parts of it are invalidated: nothing else may be sent
+    fill(toast, 40 * 40, 0xFFFF);
+    TEST_ESP_OK(esp_lcd_st77912_compositor_invalidate(s_comp, layer_id, 5, 6, 15, 16));
+    TEST_ESP_OK(esp_lcd_st77912_compositor_invalidate(s_comp, layer_id, 30, 30, 38, 34));
+    mock_lcd_io_stats_t before;
+    mock_lcd_io_get_stats(s_fx.io, &before);
+    flush_and_wait();
+    mock_lcd_io_stats_t after;
+    mock_lcd_io_get_stats(s_fx.io, &after);
+    TEST_ASSERT_EQUAL(2, after.completions - before.completions);
+    TEST_ASSERT_EQUAL((10 * 10 + 8 * 4) * 2, after.color_bytes - before.color_bytes);
+    mock_lcd_panel_state_t state;
+    mock_lcd_panel_get_state(s_fx.mock, &state);
+    TEST_ASSERT_EQUAL(130, state.caset[0]);
+    TEST_ASSERT_EQUAL(137, state.caset[1]);
+    TEST_ASSERT_EQUAL(130, state.raset[0]);
+    TEST_ASSERT_EQUAL(133, state.raset[1]);
+
+    TEST_ASSERT_EQUAL(sent(0xFFFF), mock_lcd_panel_get_pixel(s_fx.mock, 105, 106));
+    TEST_ASSERT_EQUAL(sent(0xFFFF), mock_lcd_panel_get_pixel(s_fx.mock, 114, 115));
+    TEST_ASSERT_EQUAL(sent(0xFFFF), mock_lcd_panel_get_pixel(s_fx.mock, 137, 133));
+    TEST_ASSERT_EQUAL(sent(0xF800), mock_lcd_panel_get_pixel(s_fx.mock, 104, 106));
+    TEST_ASSERT_EQUAL(sent(0xF800), mock_lcd_panel_get_pixel(s_fx.mock, 115, 115));
+    TEST_ASSERT_EQUAL(sent(0xF800), mock_lcd_panel_get_pixel(s_fx.mock, 120, 120));
+    TEST_ASSERT_EQUAL(sent(0xF800), mock_lcd_panel_get_pixel(s_fx.mock, 138, 134));
+    teardown();
+}
+
+int main(void)
+{
+    host_clock_set_virtual(true);
+    RUN_TEST(test_del_waits_for_bands);
+    RUN_TEST(test_foreign_completions);
+    RUN_TEST(test_foreign_transfer_before_flush);
+    RUN_TEST(test_alpha_swapped);
+    RUN_TEST(test_alpha_native);
+    RUN_TEST(test_color_key);
+    RUN_TEST(test_invalidate_sends_window);
+    return 0;
+}
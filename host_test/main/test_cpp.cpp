@@ -0,0 +1,211 @@
+#include <atomic>
+#include <utility>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "driver/gpio.h"
+#include "esp_lcd_panel_commands.h"
+#include "esp_timer.h"
+#include "mock_lcd_panel.h"
+#include "test_fixture.h"
+#include "test_utils.h"
+
+#include "esp_lcd_st77912.hpp"
+
+using Lcd = esp_lcd_st77912::Panel<TEST_H_RES, TEST_V_RES>;
+
+#define TEST_RESET_GPIO             (9)
+#define TEST_BAND_LINES             (20)
+
+struct test_area_t {
+    int calls;
+    int x_start;
+    int y_start;
+    int x_end;
+    int y_end;
+    size_t bytes;
+};
+
+static test_fixture_t s_fx;
+static test_area_t s_drawn;
+static test_area_t s_recovered;
+
+static void on_draw(esp_lcd_panel_handle_t panel, int x_start, int y_start, int x_end, int y_end, size_t bytes, void *user_ctx)
+{
+    s_drawn = {s_drawn.calls + 1, x_start, y_start, x_end, y_end, bytes};
+}
+
+static void on_recover(esp_lcd_panel_handle_t panel, int x_start, int y_start, int x_end, int y_end, void *user_ctx)
+{
+    s_recovered = {s_recovered.calls + 1, x_start, y_start, x_end, y_end, 0};
+}
+
+// Panel::create() makes the driver, the fixture only the mock and its IO
+static void setup(bool async)
+{
+    test_fixture_config_t config = {};
+    config.async = async;
+    config.no_panel = true;
+    test_fixture_setup(&config, &s_fx);
+    s_drawn = {};
+    s_recovered = {};
+}
+
+static void test_create_config()
+{
+    setup(false);
+    {
+        esp_lcd_st77912::PanelConfig config;
+        config.reset_gpio_num = TEST_RESET_GPIO;
+        config.reset_active_high = true;
+        config.rgb_ele_order = LCD_RGB_ELEMENT_ORDER_BGR;
+        Lcd lcd;
+        TEST_ESP_OK(Lcd::create(s_fx.io, config, &lcd));
+
+        // pulsed high, left low
+        TEST_ASSERT_TRUE(host_gpio_get_writes(TEST_RESET_GPIO) >= 2);
+        TEST_ASSERT_EQUAL(0, host_gpio_get_level(TEST_RESET_GPIO));
+        mock_lcd_panel_state_t state;
+        mock_lcd_panel_get_state(s_fx.mock, &state);
+        TEST_ASSERT_EQUAL(LCD_CMD_BGR_BIT, state.madctl & LCD_CMD_BGR_BIT);
+        TEST_ASSERT_TRUE(state.display_on);
+    }
+    test_fixture_teardown(&s_fx);
+}
+
+static void test_draw_reports_area()
+{
+    setup(false);
+    {
+        Lcd lcd;
+        TEST_ESP_OK(Lcd::create(s_fx.io, -1, &lcd));
+        st77912_panel_hooks_t hooks = {};
+        hooks.on_draw = on_draw;
+        TEST_ESP_OK(esp_lcd_st77912_set_hooks(lcd.handle(), &hooks));
+        st77912_recovery_config_t recovery_config = {};
+        recovery_config.on_recover = on_recover;
+        TEST_ESP_OK(esp_lcd_st77912_set_recovery(lcd.handle(), &recovery_config));
+
+        static uint16_t pixels[Lcd::h_res * TEST_BAND_LINES];
+        TEST_ESP_OK(lcd.draw(10, 30, 50, 40, pixels));
+        TEST_ASSERT_EQUAL(1, s_drawn.calls);
+        TEST_ASSERT_EQUAL(10, s_drawn.x_start);
+        TEST_ASSERT_EQUAL(30, s_drawn.y_start);
+        TEST_ASSERT_EQUAL(50, s_drawn.x_end);
+        TEST_ASSERT_EQUAL(40, s_drawn.y_end);
+        TEST_ASSERT_EQUAL(40 * 10 * 2, s_drawn.bytes);
+        TEST_ESP_OK((lcd.draw<0, 220, 240, 240>(pixels)));
+        TEST_ASSERT_EQUAL(2, s_drawn.calls);
+        TEST_ASSERT_EQUAL(220, s_drawn.y_start);
+        TEST_ASSERT_EQUAL(Lcd::band_bytes(TEST_BAND_LINES), s_drawn.bytes);
+
+        // both windows are redrawn after the panel lost its GRAM
+        mock_lcd_panel_self_reset(s_fx.mock);
+        TEST_ESP_OK(esp_lcd_st77912_check_health(lcd.handle()));
+        TEST_ASSERT_EQUAL(1, s_recovered.calls);
+        TEST_ASSERT_EQUAL(0, s_recovered.x_start);
+        TEST_ASSERT_EQUAL(30, s_recovered.y_start);
+        TEST_ASSERT_EQUAL(240, s_recovered.x_end);
+        TEST_ASSERT_EQUAL(240, s_recovered.y_end);
+        TEST_ESP_OK(esp_lcd_st77912_set_hooks(lcd.handle(), nullptr));
+    }
+    test_fixture_teardown(&s_fx);
+}
+
+static void test_frame_pool()
+{
+    setup(true);
+    {
+        Lcd lcd;
+        TEST_ESP_OK(Lcd::create(s_fx.io, -1, &lcd));
+        st77912_panel_hooks_t hooks = {};
+        hooks.on_draw = on_draw;
+        TEST_ESP_OK(esp_lcd_st77912_set_hooks(lcd.handle(), &hooks));
+        {
+            // destroyed without init: no buffers, no callback to remove
+            esp_lcd_st77912::FramePool<Lcd, TEST_BAND_LINES> unused;
+        }
+        esp_lcd_st77912::FramePool<Lcd, TEST_BAND_LINES> pool;
+        TEST_ESP_OK(pool.init(lcd, MALLOC_CAP_DEFAULT));
+        TEST_ESP_ERR(ESP_ERR_INVALID_STATE, pool.init(lcd, MALLOC_CAP_DEFAULT));
+        for (int y = 0; y < Lcd::v_res; y += TEST_BAND_LINES) {
+            auto frame = pool.acquire();
+            TEST_ASSERT_TRUE(frame);
+            for (size_t i = 0; i < decltype(pool)::band_pixels; i++) {
+                frame.pixels()[i] = __builtin_bswap16(0xF800);
+            }
+            TEST_ESP_OK(pool.submit(std::move(frame), 0, y));
+        }
+        TEST_ASSERT_EQUAL(Lcd::v_res / TEST_BAND_LINES, s_drawn.calls);
+        TEST_ESP_OK(esp_lcd_st77912_set_hooks(lcd.handle(), nullptr));
+    }
+    // the pool went first and waited for its bands
+    mock_lcd_io_stats_t stats;
+    mock_lcd_io_get_stats(s_fx.io, &stats);
+    TEST_ASSERT_EQUAL(0, stats.inflight_modified);
+    TEST_ASSERT_EQUAL(0xFC0000, mock_lcd_panel_get_pixel(s_fx.mock, 120, 239));
+    test_fixture_teardown(&s_fx);
+}
+
+using Pool = esp_lcd_st77912::FramePool<Lcd, TEST_BAND_LINES>;
+
+static std::atomic<bool> s_pool_gone;
+
+static void *delete_pool(void *arg)
+{
+    delete static_cast<Pool *>(arg);
+    s_pool_gone = true;
+    return nullptr;
+}
+
+static void test_frame_pool_foreign_draw()
+{
+    setup(true);
+    {
+        Lcd lcd;
+        TEST_ESP_OK(Lcd::create(s_fx.io, -1, &lcd));
+        Pool *pool = new Pool;
+        TEST_ESP_OK(pool->init(lcd, MALLOC_CAP_DEFAULT));
+
+        mock_lcd_io_hold(s_fx.io, true);
+        TEST_ESP_OK(pool->submit(pool->acquire(), 0, 0));
+        {
+            auto frame = pool->acquire(0);
+            TEST_ASSERT_TRUE(frame);
+            // pixels sent around the pool while its band is in flight, completing after it
+            static uint16_t line[Lcd::h_res];
+            TEST_ESP_OK(esp_lcd_panel_io_tx_color(s_fx.io, LCD_CMD_RAMWRC, line, sizeof(line)));
+            TEST_ASSERT_EQUAL(2, mock_lcd_io_inflight(s_fx.io));
+            mock_lcd_io_hold(s_fx.io, false);
+            mock_lcd_io_wait_idle(s_fx.io);
+            mock_lcd_io_hold(s_fx.io, true);
+            TEST_ESP_OK(pool->submit(std::move(frame), 0, TEST_BAND_LINES));
+        }
+        TEST_ASSERT_EQUAL(1, mock_lcd_io_inflight(s_fx.io));
+
+        // the foreign completion freed no buffer, so the pool still waits for the band on the bus
+        pthread_t thread;
+        s_pool_gone = false;
+        pthread_create(&thread, nullptr, delete_pool, pool);
+        usleep(50 * 1000);
+        TEST_ASSERT_FALSE(s_pool_gone);
+        mock_lcd_io_hold(s_fx.io, false);
+        pthread_join(thread, nullptr);
+        TEST_ASSERT_TRUE(s_pool_gone);
+    }
+    mock_lcd_io_stats_t stats;
+    mock_lcd_io_get_stats(s_fx.io, &stats);
+    TEST_ASSERT_EQUAL(0, stats.inflight_modified);
+    test_fixture_teardown(&s_fx);
+}
+
+int main()
+{
+    host_clock_set_virtual(true);
+    RUN_TEST(test_create_config);
+    RUN_TEST(test_draw_reports_area);
+    RUN_TEST(test_frame_pool);
+    RUN_TEST(test_frame_pool_foreign_draw);
+    return 0;
+}
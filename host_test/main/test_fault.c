@@ -0,0 +1,242 @@
+#include <string.h>
+
+#include "esp_lcd_panel_ops.h"
+#include "esp_timer.h"
+#include "mock_lcd_panel.h"
+#include "test_utils.h"
+
+#include "esp_lcd_st77912.h"
+
+#define TEST_H_RES                  (240)
+#define TEST_V_RES                  (240)
+
+typedef struct {
+    int calls;
+    int x_start;
+    int y_start;
+    int x_end;
+    int y_end;
+} test_area_t;
+
+static mock_lcd_panel_t *s_mock;
+static esp_lcd_panel_io_handle_t s_io;
+static esp_lcd_panel_handle_t s_panel;
+static test_area_t s_recovered;
+static int s_inits;
+
+static void on_recover(esp_lcd_panel_handle_t panel, int x_start, int y_start, int x_end, int y_end, void *user_ctx)
+{
+    s_recovered = (test_area_t) {s_recovered.calls + 1, x_start, y_start, x_end, y_end};
+}
+
+static void on_init(esp_lcd_panel_handle_t panel, void *user_ctx)
+{
+    s_inits++;
+}
+
+static void setup(lcd_rgb_element_order_t order, bool qspi)
+{
+    mock_lcd_panel_config_t mock_config = {
+        .width = TEST_H_RES,
+        .height = TEST_V_RES,
+    };
+    TEST_ESP_OK(mock_lcd_panel_new(&mock_config, &s_mock));
+    mock_lcd_io_config_t io_config = {
+        .pclk_hz = 40 * 1000 * 1000,
+    };
+    TEST_ESP_OK(mock_lcd_io_new(s_mock, &io_config, &s_io));
+
+    st77912_vendor_config_t vendor_config = {
+        .flags.use_qspi_interface = qspi,
+    };
+    esp_lcd_panel_dev_config_t panel_config = {
+        .reset_gpio_num = -1,
+        .rgb_ele_order = order,
+        .bits_per_pixel = 16,
+        .vendor_config = &vendor_config,
+    };
+    TEST_ESP_OK(esp_lcd_new_panel_st77912(s_io, &panel_config, &s_panel));
+    st77912_recovery_config_t recovery_config = {
+        .max_tx_retries = 2,
+        .on_recover = on_recover,
+    };
+    TEST_ESP_OK(esp_lcd_st77912_set_recovery(s_panel, &recovery_config));
+    st77912_panel_hooks_t hooks = {
+        .on_init = on_init,
+    };
+    TEST_ESP_OK(esp_lcd_st77912_set_hooks(s_panel, &hooks));
+    TEST_ESP_OK(esp_lcd_panel_reset(s_panel));
+    TEST_ESP_OK(esp_lcd_panel_init(s_panel));
+    TEST_ESP_OK(esp_lcd_panel_disp_on_off(s_panel, true));
+    s_recovered = (test_area_t) {0};
+    s_inits = 0;
+}
+
+static void teardown(void)
+{
+    TEST_ESP_OK(esp_lcd_panel_del(s_panel));
+    TEST_ESP_OK(esp_lcd_panel_io_del(s_io));
+    mock_lcd_panel_del(s_mock);
+}
+
+static void draw_red(int x_start, int y_start, int x_end, int y_end, esp_err_t expected)
+{
+    static uint8_t red[TEST_H_RES * TEST_V_RES * 2];
+    for (size_t i = 0; i < sizeof(red); i += 2) {
+        red[i] = 0xF8;
+        red[i + 1] = 0x00;
+    }
+    TEST_ESP_ERR(expected, esp_lcd_panel_draw_bitmap(s_panel, x_start, y_start, x_end, y_end, red));
+}
+
+static st77912_fault_stats_t get_stats(void)
+{
+    st77912_fault_stats_t stats;
+    TEST_ESP_OK(esp_lcd_st77912_get_fault_stats(s_panel, &stats));
+    return stats;
+}
+
+static void test_retry_success(void)
+{
+    setup(LCD_RGB_ELEMENT_ORDER_RGB, false);
+    mock_lcd_io_fail(s_io, MOCK_LCD_OP_TX_COLOR, 1, 1, ESP_ERR_TIMEOUT);
+    draw_red(10, 20, 30, 40, ESP_OK);
+
+    st77912_fault_stats_t stats = get_stats();
+    TEST_ASSERT_EQUAL(1, stats.tx_errors);
+    TEST_ASSERT_EQUAL(1, stats.tx_retries);
+    TEST_ASSERT_EQUAL(0, stats.tx_failures);
+    TEST_ASSERT_EQUAL(0xFC0000, mock_lcd_panel_get_pixel(s_mock, 10, 20));
+    TEST_ASSERT_EQUAL(0xFC0000, mock_lcd_panel_get_pixel(s_mock, 29, 39));
+    TEST_ASSERT_EQUAL(0, mock_lcd_panel_get_pixel(s_mock, 30, 40));
+
+    // a failing CASET is retried the same way
+    mock_lcd_io_fail(s_io, MOCK_LCD_OP_TX_PARAM, 1, 1, ESP_FAIL);
+    draw_red(0, 0, 8, 8, ESP_OK);
+    stats = get_stats();
+    TEST_ASSERT_EQUAL(2, stats.tx_errors);
+    TEST_ASSERT_EQUAL(2, stats.tx_retries);
+    teardown();
+}
+
+static void test_retry_exhausted(void)
+{
+    setup(LCD_RGB_ELEMENT_ORDER_RGB, false);
+    mock_lcd_io_fail(s_io, MOCK_LCD_OP_TX_COLOR, 1, 3, ESP_ERR_TIMEOUT);
+    draw_red(50, 60, 70, 80, ESP_ERR_TIMEOUT);
+
+    st77912_fault_stats_t stats = get_stats();
+    TEST_ASSERT_EQUAL(3, stats.tx_errors);
+    TEST_ASSERT_EQUAL(2, stats.tx_retries);
+    TEST_ASSERT_EQUAL(1, stats.tx_failures);
+    mock_lcd_io_stats_t io_stats;
+    mock_lcd_io_get_stats(s_io, &io_stats);
+    TEST_ASSERT_EQUAL(3, io_stats.failures[MOCK_LCD_OP_TX_COLOR]);
+
+    // no reset, so only the lost window comes back for a redraw, and only once
+    TEST_ESP_OK(esp_lcd_st77912_check_health(s_panel));
+    stats = get_stats();
+    TEST_ASSERT_EQUAL(0, stats.panel_resets);
+    TEST_ASSERT_EQUAL(1, s_recovered.calls);
+    TEST_ASSERT_EQUAL(50, s_recovered.x_start);
+    TEST_ASSERT_EQUAL(60, s_recovered.y_start);
+    TEST_ASSERT_EQUAL(70, s_recovered.x_end);
+    TEST_ASSERT_EQUAL(80, s_recovered.y_end);
+    TEST_ESP_OK(esp_lcd_st77912_check_health(s_panel));
+    TEST_ASSERT_EQUAL(1, s_recovered.calls);
+    teardown();
+}
+
+static void test_no_false_positive(void)
+{
+    // BGR and every MADCTL bit the API can set: the status must match what the driver thinks it sent
+    setup(LCD_RGB_ELEMENT_ORDER_BGR, false);
+    TEST_ESP_OK(esp_lcd_st77912_check_health(s_panel));
+    TEST_ESP_OK(esp_lcd_panel_mirror(s_panel, true, true));
+    TEST_ESP_OK(esp_lcd_panel_swap_xy(s_panel, true));
+    TEST_ESP_OK(esp_lcd_panel_invert_color(s_panel, false));
+    TEST_ESP_OK(esp_lcd_st77912_check_health(s_panel));
+
+    mock_lcd_panel_state_t state;
+    mock_lcd_panel_get_state(s_mock, &state);
+    TEST_ASSERT_EQUAL(0xE8, state.madctl);
+    TEST_ASSERT_EQUAL(0x55, state.colmod);
+    TEST_ASSERT_EQUAL(0, get_stats().panel_resets);
+    TEST_ASSERT_EQUAL(0, s_recovered.calls);
+    teardown();
+
+    setup(LCD_RGB_ELEMENT_ORDER_RGB, true);
+    TEST_ESP_OK(esp_lcd_panel_mirror(s_panel, true, false));
+    TEST_ESP_OK(esp_lcd_st77912_check_health(s_panel));
+    TEST_ASSERT_EQUAL(0, get_stats().panel_resets);
+    teardown();
+}
+
+static void test_self_reset_recovery(void)
+{
+    setup(LCD_RGB_ELEMENT_ORDER_BGR, false);
+    TEST_ESP_OK(esp_lcd_panel_mirror(s_panel, true, false));
+    TEST_ESP_OK(esp_lcd_panel_invert_color(s_panel, false));
+    draw_red(0, 0, 100, 20, ESP_OK);
+    mock_lcd_io_fail(s_io, MOCK_LCD_OP_TX_COLOR, 1, 3, ESP_ERR_TIMEOUT);
+    draw_red(150, 200, 240, 240, ESP_ERR_TIMEOUT);
+    mock_lcd_panel_state_t before;
+    mock_lcd_panel_get_state(s_mock, &before);
+
+    mock_lcd_panel_self_reset(s_mock);
+    int64_t start = esp_timer_get_time();
+    TEST_ESP_OK(esp_lcd_st77912_check_health(s_panel));
+    // no SWRESET and its 120 ms, SLPOUT only waits 5 ms
+    TEST_ASSERT_TRUE(esp_timer_get_time() - start < 20 * 1000);
+
+    st77912_fault_stats_t stats = get_stats();
+    TEST_ASSERT_EQUAL(1, stats.panel_resets);
+    TEST_ASSERT_EQUAL(1, stats.recoveries);
+    TEST_ASSERT_EQUAL(1, s_inits);
+    mock_lcd_panel_state_t after;
+    mock_lcd_panel_get_state(s_mock, &after);
+    TEST_ASSERT_EQUAL(before.swresets, after.swresets);
+    TEST_ASSERT_TRUE(after.sleep_out);
+    TEST_ASSERT_TRUE(after.display_on);
+    TEST_ASSERT_FALSE(after.inverted);
+    TEST_ASSERT_EQUAL(before.madctl, after.madctl);
+    TEST_ASSERT_EQUAL(0x55, after.colmod);
+
+    // drawn and lost areas together
+    TEST_ASSERT_EQUAL(1, s_recovered.calls);
+    TEST_ASSERT_EQUAL(0, s_recovered.x_start);
+    TEST_ASSERT_EQUAL(0, s_recovered.y_start);
+    TEST_ASSERT_EQUAL(240, s_recovered.x_end);
+    TEST_ASSERT_EQUAL(240, s_recovered.y_end);
+
+    // healthy again
+    TEST_ESP_OK(esp_lcd_st77912_check_health(s_panel));
+    TEST_ASSERT_EQUAL(1, get_stats().panel_resets);
+    TEST_ASSERT_EQUAL(1, s_recovered.calls);
+    teardown();
+}
+
+static void test_rx_error(void)
+{
+    setup(LCD_RGB_ELEMENT_ORDER_RGB, false);
+    mock_lcd_io_fail(s_io, MOCK_LCD_OP_RX_PARAM, 1, 1, ESP_ERR_TIMEOUT);
+    TEST_ESP_ERR(ESP_ERR_TIMEOUT, esp_lcd_st77912_check_health(s_panel));
+    st77912_fault_stats_t stats = get_stats();
+    TEST_ASSERT_EQUAL(1, stats.rx_errors);
+    TEST_ASSERT_EQUAL(0, stats.tx_errors);
+    TEST_ASSERT_EQUAL(0, stats.panel_resets);
+    TEST_ESP_OK(esp_lcd_st77912_check_health(s_panel));
+    TEST_ASSERT_EQUAL(1, get_stats().rx_errors);
+    teardown();
+}
+
+int main(void)
+{
+    host_clock_set_virtual(true);
+    RUN_TEST(test_retry_success);
+    RUN_TEST(test_retry_exhausted);
+    RUN_TEST(test_no_false_positive);
+    RUN_TEST(test_self_reset_recovery);
+    RUN_TEST(test_rx_error);
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include "esp_lcd_panel_ops.h"
+#include "test_fixture.h"
+#include "test_utils.h"
+
+#include "esp_lcd_st77912.h"
+
+void test_fixture_setup(const test_fixture_config_t *config, test_fixture_t *ret_fixture)
+{
+    *ret_fixture = (test_fixture_t) {0};
+    mock_lcd_panel_config_t mock_config = {
+        .width = TEST_H_RES,
+        .height = TEST_V_RES,
+    };
+    TEST_ESP_OK(mock_lcd_panel_new(&mock_config, &ret_fixture->mock));
+    mock_lcd_io_config_t io_config = {
+        .pclk_hz = TEST_PCLK_HZ,
+        .async = config->async,
+    };
+    TEST_ESP_OK(mock_lcd_io_new(ret_fixture->mock, &io_config, &ret_fixture->io));
+    if (config->no_panel) {
+        return;
+    }
+    esp_lcd_panel_dev_config_t panel_config = {
+        .reset_gpio_num = -1,
+        .rgb_ele_order = config->rgb_ele_order,
+        .bits_per_pixel = config->bits_per_pixel ? config->bits_per_pixel : 16,
+    };
+    TEST_ESP_OK(esp_lcd_new_panel_st77912(ret_fixture->io, &panel_config, &ret_fixture->panel));
+    if (!config->no_init) {
+        TEST_ESP_OK(esp_lcd_panel_init(ret_fixture->panel));
+    }
+}
+
+void test_fixture_teardown(test_fixture_t *fixture)
+{
+    if (fixture->panel) {
+        TEST_ESP_OK(esp_lcd_panel_del(fixture->panel));
+    }
+    TEST_ESP_OK(esp_lcd_panel_io_del(fixture->io));
+    mock_lcd_panel_del(fixture->mock);
+    *fixture = (test_fixture_t) {0};
+}
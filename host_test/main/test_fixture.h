@@ -0,0 +1,39 @@
+#pragma once
+
+// the mock panel, a mock IO in front of it and the driver on that IO, as most tests start out
+
+#include <stdbool.h>
+
+#include "esp_lcd_types.h"
+#include "mock_lcd_panel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TEST_H_RES                  (240)
+#define TEST_V_RES                  (240)
+#define TEST_PCLK_HZ                (40 * 1000 * 1000)
+
+typedef struct {
+    int bits_per_pixel;                     // 0 for 16
+    lcd_rgb_element_order_t rgb_ele_order;
+    bool async;                             // transfers complete on the IO's own thread, in order
+    bool no_init;                           // leave reset and init to the test
+    bool no_panel;                          // only the mock and the IO, the test creates the driver itself
+} test_fixture_config_t;
+
+typedef struct {
+    mock_lcd_panel_t *mock;
+    esp_lcd_panel_io_handle_t io;
+    esp_lcd_panel_handle_t panel;
+} test_fixture_t;
+
+void test_fixture_setup(const test_fixture_config_t *config, test_fixture_t *ret_fixture);
+
+// deletes the driver (if the fixture created it), the IO and the mock
+void test_fixture_teardown(test_fixture_t *fixture);
+
+#ifdef __cplusplus
+}
+#endif
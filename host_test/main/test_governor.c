@@ -0,0 +1,132 @@
+#include "esp_lcd_panel_ops.h"
+#include "esp_timer.h"
+#include "mock_lcd_panel.h"
+#include "test_fixture.h"
+#include "test_utils.h"
+
+#include "esp_lcd_st77912.h"
+#include "esp_lcd_st77912_governor.h"
+
+static test_fixture_t s_fx;
+static int s_user_draws;
+
+static const st77912_governor_mode_t s_modes[] = {
+    {.host_fps = 10, .panel_hz = 30, .exit_percent = 0},
+    {.host_fps = 60, .panel_hz = 60, .enter_percent = 100, .exit_percent = 50},
+};
+
+static void user_on_draw(esp_lcd_panel_handle_t panel, int x_start, int y_start, int x_end, int y_end, size_t bytes, void *user_ctx)
+{
+    s_user_draws++;
+}
+
+static void setup(void)
+{
+    test_fixture_setup(&(test_fixture_config_t) {0}, &s_fx);
+    s_user_draws = 0;
+}
+
+// redraw the whole screen once and let a window pass, the governor should see it
+static uint32_t full_frame_activity(st77912_governor_handle_t gov)
+{
+    static uint16_t pixels[TEST_H_RES * 40];
+    for (int y = 0; y < TEST_V_RES; y += 40) {
+        TEST_ESP_OK(esp_lcd_panel_draw_bitmap(s_fx.panel, 0, y, TEST_H_RES, y + 40, pixels));
+    }
+    host_clock_advance(250 * 1000);
+    TEST_ESP_OK(esp_lcd_st77912_governor_update(gov));
+    st77912_governor_stats_t stats;
+    TEST_ESP_OK(esp_lcd_st77912_governor_get_stats(gov, &stats));
+    return stats.activity_percent;
+}
+
+static void test_hooks_taken(void)
+{
+    setup();
+    st77912_governor_config_t config = ST77912_GOVERNOR_CONFIG(s_fx.panel, TEST_H_RES, TEST_V_RES, s_modes, 2, 40 * 1000 * 1000, 1);
+    st77912_governor_handle_t gov = NULL;
+    TEST_ESP_OK(esp_lcd_st77912_governor_new(&config, &gov));
+
+    // neither a second governor nor the application can take the slot over
+    st77912_governor_handle_t other = NULL;
+    TEST_ESP_ERR(ESP_ERR_INVALID_STATE, esp_lcd_st77912_governor_new(&config, &other));
+    TEST_ASSERT_TRUE(other == NULL);
+    st77912_panel_hooks_t hooks = {
+        .on_draw = user_on_draw,
+    };
+    TEST_ESP_ERR(ESP_ERR_INVALID_STATE, esp_lcd_st77912_set_hooks(s_fx.panel, &hooks));
+    TEST_ASSERT_EQUAL(400, full_frame_activity(gov));
+    TEST_ASSERT_EQUAL(0, s_user_draws);
+
+    // the slot is free again once the governor is gone
+    TEST_ESP_OK(esp_lcd_st77912_governor_del(gov));
+    TEST_ESP_OK(esp_lcd_st77912_set_hooks(s_fx.panel, &hooks));
+    static uint16_t line[TEST_H_RES];
+    TEST_ESP_OK(esp_lcd_panel_draw_bitmap(s_fx.panel, 0, 0, TEST_H_RES, 1, line));
+    TEST_ASSERT_EQUAL(1, s_user_draws);
+    TEST_ESP_OK(esp_lcd_st77912_set_hooks(s_fx.panel, NULL));
+    test_fixture_teardown(&s_fx);
+}
+
+static void test_del_keeps_other_hooks(void)
+{
+    setup();
+    st77912_governor_config_t config = ST77912_GOVERNOR_CONFIG(s_fx.panel, TEST_H_RES, TEST_V_RES, s_modes, 2, 40 * 1000 * 1000, 1);
+    st77912_governor_handle_t gov = NULL;
+    TEST_ESP_OK(esp_lcd_st77912_governor_new(&config, &gov));
+
+    // the application removed the governor's hooks and put its own in place before deleting the governor
+    TEST_ESP_OK(esp_lcd_st77912_set_hooks(s_fx.panel, NULL));
+    st77912_panel_hooks_t hooks = {
+        .on_draw = user_on_draw,
+    };
+    TEST_ESP_OK(esp_lcd_st77912_set_hooks(s_fx.panel, &hooks));
+    TEST_ESP_OK(esp_lcd_st77912_governor_del(gov));
+
+    st77912_panel_hooks_t current;
+    TEST_ESP_OK(esp_lcd_st77912_get_hooks(s_fx.panel, &current));
+    TEST_ASSERT_TRUE(current.on_draw == user_on_draw);
+    static uint16_t line[TEST_H_RES];
+    TEST_ESP_OK(esp_lcd_panel_draw_bitmap(s_fx.panel, 0, 0, TEST_H_RES, 1, line));
+    TEST_ASSERT_EQUAL(1, s_user_draws);
+    test_fixture_teardown(&s_fx);
+}
+
+static void test_wait_frame_rate(void)
+{
+    setup();
+    // 1000 / 60 ms isn't a whole number of ticks
+    static const st77912_governor_mode_t modes[] = {
+        {.host_fps = 60, .panel_hz = 60},
+    };
+    st77912_governor_config_t config = ST77912_GOVERNOR_CONFIG(s_fx.panel, TEST_H_RES, TEST_V_RES, modes, 1, 40 * 1000 * 1000, 1);
+    st77912_governor_handle_t gov = NULL;
+    TEST_ESP_OK(esp_lcd_st77912_governor_new(&config, &gov));
+
+    TEST_ESP_OK(esp_lcd_st77912_governor_wait_frame(gov));
+    int64_t start_us = esp_timer_get_time();
+    for (int i = 0; i < 120; i++) {
+        TEST_ESP_OK(esp_lcd_st77912_governor_wait_frame(gov));
+    }
+    // two seconds, not the 1.92 s of a period rounded down to 16 ms
+    TEST_ASSERT_INT_WITHIN(1000, 2000 * 1000, esp_timer_get_time() - start_us);
+
+    // a late frame isn't made up for with a burst
+    host_clock_advance(100 * 1000);
+    TEST_ESP_OK(esp_lcd_st77912_governor_wait_frame(gov));
+    start_us = esp_timer_get_time();
+    TEST_ESP_OK(esp_lcd_st77912_governor_wait_frame(gov));
+    TEST_ASSERT_INT_WITHIN(1000, 16667, esp_timer_get_time() - start_us);
+
+    TEST_ESP_OK(esp_lcd_st77912_governor_del(gov));
+    test_fixture_teardown(&s_fx);
+}
+
+int main(void)
+{
+    host_clock_set_virtual(true);
+    RUN_TEST(test_hooks_taken);
+    RUN_TEST(test_del_keeps_other_hooks);
+    RUN_TEST(test_wait_frame_rate);
+    return 0;
+}
@@ -0,0 +1,201 @@
+#include <string.h>
+#include <sys/param.h>
+
+#include "test_utils.h"
+
+#include "esp_lcd_st77912_jpeg.h"
+
+// decoded pixels against libjpeg's, see jpeg/gen_clips.py. RGB565 keeps 5/6 bits, a component may be off by
+// one step of those where the 8-bit values sit next to a rounding boundary, and must not drift on average.
+// libjpeg interpolates subsampled chroma where the decoder repeats it, which costs one more step
+#define TEST_MAX_MEAN_BIAS          (0.1)
+
+static uint8_t *load_file(const char *path, size_t *ret_len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "cannot open %s, run the test from host_test\n", path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    size_t len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(len);
+    TEST_ASSERT_TRUE(data);
+    TEST_ASSERT_EQUAL(len, fread(data, 1, len, f));
+    fclose(f);
+    *ret_len = len;
+    return data;
+}
+
+static uint16_t *decode(st77912_jpeg_dec_t *dec, const uint8_t *data, size_t len, bool swap_bytes)
+{
+    TEST_ESP_OK(esp_lcd_st77912_jpeg_start(dec, data, len));
+    // the last MCU row is written in full, past the image height
+    uint16_t *out = malloc(dec->width * dec->mcus_y * dec->mcu_h * sizeof(uint16_t));
+    TEST_ASSERT_TRUE(out);
+    int y = 0;
+    int lines = 0;
+    do {
+        TEST_ESP_OK(esp_lcd_st77912_jpeg_decode_rows(dec, out + y * dec->width, dec->width, swap_bytes, &lines));
+        y += lines;
+    } while (lines);
+    TEST_ASSERT_EQUAL(dec->height, y);
+    return out;
+}
+
+static void check_component(int value, int bits, uint8_t expected, int *max_diff, double *bias)
+{
+    int diff = value - (expected >> (8 - bits));
+    *max_diff = MAX(*max_diff, abs(diff));
+    *bias += diff;
+}
+
+static void check_frame(const char *name, int width, int height, int mcu_w, int mcu_h, int max_allowed)
+{
+    char path[64];
+    size_t len, ref_len;
+    snprintf(path, sizeof(path), "jpeg/%s.jpg", name);
+    uint8_t *data = load_file(path, &len);
+    snprintf(path, sizeof(path), "jpeg/%s.rgb", name);
+    uint8_t *ref = load_file(path, &ref_len);
+
+    static st77912_jpeg_dec_t dec;
+    memset(&dec, 0, sizeof(dec));
+    uint16_t *out = decode(&dec, data, len, false);
+    TEST_ASSERT_EQUAL(width, dec.width);
+    TEST_ASSERT_EQUAL(height, dec.height);
+    TEST_ASSERT_EQUAL(mcu_w, dec.mcu_w);
+    TEST_ASSERT_EQUAL(mcu_h, dec.mcu_h);
+    TEST_ASSERT_EQUAL((size_t)width * height * 3, ref_len);
+
+    int max_diff = 0;
+    double bias[3] = {0};
+    for (int i = 0; i < width * height; i++) {
+        check_component(out[i] >> 11, 5, ref[i * 3], &max_diff, &bias[0]);
+        check_component((out[i] >> 5) & 0x3F, 6, ref[i * 3 + 1], &max_diff, &bias[1]);
+        check_component(out[i] & 0x1F, 5, ref[i * 3 + 2], &max_diff, &bias[2]);
+    }
+    for (int c = 0; c < 3; c++) {
+        bias[c] /= width * height;
+        if (bias[c] > TEST_MAX_MEAN_BIAS || bias[c] < -TEST_MAX_MEAN_BIAS) {
+            fprintf(stderr, "%s: component %d is off by %.3f steps on average\n", name, c, bias[c]);
+            TEST_FAIL_MESSAGE("decoded colors drift from the reference");
+        }
+    }
+    if (max_diff > max_allowed) {
+        fprintf(stderr, "%s: a component is off by %d steps\n", name, max_diff);
+        TEST_FAIL_MESSAGE("decoded pixels differ from the reference");
+    }
+
+    // the same image again with the pixels byte-swapped for the bus
+    uint16_t *swapped = decode(&dec, data, len, true);
+    for (int i = 0; i < width * height; i++) {
+        TEST_ASSERT_EQUAL(__builtin_bswap16(out[i]), swapped[i]);
+    }
+    free(swapped);
+    free(out);
+    free(ref);
+    free(data);
+}
+
+static void test_decode_samplings(void)
+{
+    check_frame("yuv420", 61, 45, 16, 16, 2);
+    check_frame("yuv422", 61, 45, 16, 8, 2);
+    check_frame("yuv444", 61, 45, 8, 8, 1);
+    check_frame("grey", 61, 45, 8, 8, 1);
+}
+
+// a buffer sized exactly to the bytes given, so ASan catches any read past it
+static esp_err_t start_exact(const uint8_t *bytes, size_t len)
+{
+    static st77912_jpeg_dec_t dec;
+    memset(&dec, 0, sizeof(dec));
+    uint8_t *data = malloc(len);
+    TEST_ASSERT_TRUE(data);
+    memcpy(data, bytes, len);
+    esp_err_t ret = esp_lcd_st77912_jpeg_start(&dec, data, len);
+    free(data);
+    return ret;
+}
+
+static size_t find_marker(const uint8_t *data, size_t len, uint8_t marker)
+{
+    for (size_t i = 2; i + 1 < len; i++) {
+        if (data[i] == 0xFF && data[i + 1] == marker) {
+            return i;
+        }
+    }
+    TEST_FAIL_MESSAGE("marker not found");
+    return 0;
+}
+
+static void test_malformed_segments(void)
+{
+    // DRI without its interval, at the very end of the data
+    TEST_ESP_ERR(ESP_ERR_INVALID_RESPONSE, start_exact((const uint8_t []) {
+        0xFF, 0xD8, 0xFF, 0xDD, 0x00, 0x02,
+    }, 6));
+
+    size_t len;
+    uint8_t *data = load_file("jpeg/yuv444.jpg", &len);
+    size_t sos = find_marker(data, len, 0xDA);
+
+    // SOS cut after its component count, and one whose length leaves out the selectors
+    TEST_ESP_ERR(ESP_ERR_INVALID_RESPONSE, start_exact(data, sos + 5));
+    uint8_t *copy = malloc(len);
+    memcpy(copy, data, len);
+    copy[sos + 2] = 0x00;
+    copy[sos + 3] = 0x03;
+    TEST_ESP_ERR(ESP_ERR_INVALID_RESPONSE, start_exact(copy, len));
+
+    // a 16-bit quantization table
+    memcpy(copy, data, len);
+    size_t dqt = find_marker(copy, len, 0xDB);
+    copy[dqt + 4] |= 0x10;
+    TEST_ESP_ERR(ESP_ERR_NOT_SUPPORTED, start_exact(copy, len));
+
+    TEST_ESP_OK(start_exact(data, len));
+    free(copy);
+    free(data);
+}
+
+static void test_next_frame_resync(void)
+{
+    size_t len;
+    uint8_t *frame = load_file("jpeg/grey.jpg", &len);
+    // a good frame, an SOI followed by garbage, a good frame, then a frame cut short
+    size_t clip_len = len + 4 + len + len / 2;
+    uint8_t *clip = malloc(clip_len);
+    memcpy(clip, frame, len);
+    memcpy(clip + len, (const uint8_t []) {
+        0xFF, 0xD8, 0x12, 0x34
+    }, 4);
+    memcpy(clip + len + 4, frame, len);
+    memcpy(clip + len + 4 + len, frame, len / 2);
+
+    size_t offset = 0;
+    const uint8_t *out = NULL;
+    size_t out_len = 0;
+    TEST_ESP_OK(esp_lcd_st77912_jpeg_next_frame(clip, clip_len, &offset, &out, &out_len));
+    TEST_ASSERT_TRUE(out == clip);
+    TEST_ASSERT_EQUAL(len, out_len);
+    TEST_ESP_ERR(ESP_ERR_INVALID_RESPONSE, esp_lcd_st77912_jpeg_next_frame(clip, clip_len, &offset, &out, &out_len));
+    TEST_ASSERT_EQUAL(len + 2, offset);
+    TEST_ESP_OK(esp_lcd_st77912_jpeg_next_frame(clip, clip_len, &offset, &out, &out_len));
+    TEST_ASSERT_TRUE(out == clip + len + 4);
+    TEST_ASSERT_EQUAL(len, out_len);
+    TEST_ESP_ERR(ESP_ERR_INVALID_RESPONSE, esp_lcd_st77912_jpeg_next_frame(clip, clip_len, &offset, &out, &out_len));
+    TEST_ESP_ERR(ESP_ERR_NOT_FOUND, esp_lcd_st77912_jpeg_next_frame(clip, clip_len, &offset, &out, &out_len));
+    free(clip);
+    free(frame);
+}
+
+int main(void)
+{
+    RUN_TEST(test_decode_samplings);
+    RUN_TEST(test_malformed_segments);
+    RUN_TEST(test_next_frame_resync);
+    return 0;
+}
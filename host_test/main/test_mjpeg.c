@@ -0,0 +1,179 @@
+#include <string.h>
+
+#include "esp_lcd_panel_ops.h"
+#include "esp_timer.h"
+#include "mock_lcd_panel.h"
+#include "test_fixture.h"
+#include "test_utils.h"
+
+#include "esp_lcd_st77912.h"
+#include "esp_lcd_st77912_mjpeg.h"
+
+#define TEST_MAX_FRAMES             (8)
+
+static test_fixture_t s_fx;
+static st77912_mjpeg_frame_stats_t s_frames[TEST_MAX_FRAMES];
+static int s_num_frames;
+
+static void on_frame(const st77912_mjpeg_frame_stats_t *stats, void *user_ctx)
+{
+    if (s_num_frames < TEST_MAX_FRAMES) {
+        s_frames[s_num_frames] = *stats;
+    }
+    s_num_frames++;
+}
+
+static uint8_t *load_file(const char *path, size_t *ret_len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "cannot open %s, run the test from host_test\n", path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    size_t len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(len);
+    TEST_ASSERT_TRUE(data);
+    TEST_ASSERT_EQUAL(len, fread(data, 1, len, f));
+    fclose(f);
+    *ret_len = len;
+    return data;
+}
+
+static void setup(void)
+{
+    test_fixture_setup(&(test_fixture_config_t) {
+        .async = true,
+    }, &s_fx);
+    s_num_frames = 0;
+}
+
+static void test_corrupt_frames_skipped(void)
+{
+    setup();
+    size_t grey_len, color_len;
+    uint8_t *grey = load_file("jpeg/grey.jpg", &grey_len);
+    uint8_t *color = load_file("jpeg/yuv420.jpg", &color_len);
+
+    // good, unsupported scan (two components in a three component frame), good, SOI followed by garbage, good
+    size_t clip_len = grey_len + color_len + grey_len + 4 + color_len;
+    uint8_t *clip = malloc(clip_len);
+    uint8_t *p = clip;
+    memcpy(p, grey, grey_len);
+    p += grey_len;
+    memcpy(p, color, color_len);
+    for (size_t i = 2; i + 4 < color_len; i++) {
+        if (p[i] == 0xFF && p[i + 1] == 0xDA) {
+            p[i + 4] = 2;
+            break;
+        }
+    }
+    p += color_len;
+    memcpy(p, grey, grey_len);
+    p += grey_len;
+    memcpy(p, (const uint8_t []) {
+        0xFF, 0xD8, 0x12, 0x34
+    }, 4);
+    p += 4;
+    memcpy(p, color, color_len);
+
+    st77912_mjpeg_config_t config = ST77912_MJPEG_PLAYER_CONFIG(s_fx.panel, s_fx.io, 64, 25);
+    config.on_frame = on_frame;
+    st77912_mjpeg_handle_t player = NULL;
+    TEST_ESP_OK(esp_lcd_st77912_mjpeg_new(&config, &player));
+    TEST_ESP_OK(esp_lcd_st77912_mjpeg_play(player, clip, clip_len));
+
+    st77912_mjpeg_stats_t stats;
+    TEST_ESP_OK(esp_lcd_st77912_mjpeg_get_stats(player, &stats));
+    TEST_ASSERT_EQUAL(5, stats.frames);
+    TEST_ASSERT_EQUAL(2, stats.corrupt);
+    TEST_ASSERT_EQUAL(0, stats.dropped);
+    TEST_ASSERT_EQUAL(5, s_num_frames);
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL(i, s_frames[i].frame);
+        TEST_ASSERT_EQUAL(i == 1 || i == 3, s_frames[i].corrupt);
+        TEST_ASSERT_FALSE(s_frames[i].dropped);
+    }
+    // the last frame made it to the panel, test_jpeg checks the decode itself more closely
+    size_t ref_len;
+    uint8_t *ref = load_file("jpeg/yuv420.rgb", &ref_len);
+    TEST_ASSERT_EQUAL(61 * 45 * 3, ref_len);
+    for (int y = 0; y < 45; y++) {
+        for (int x = 0; x < 61; x++) {
+            uint32_t px = mock_lcd_panel_get_pixel(s_fx.mock, x, y);
+            const uint8_t *rgb = &ref[(y * 61 + x) * 3];
+            TEST_ASSERT_INT_WITHIN(2, rgb[0] >> 3, (px >> 19) & 0x1F);
+            TEST_ASSERT_INT_WITHIN(2, rgb[1] >> 2, (px >> 10) & 0x3F);
+            TEST_ASSERT_INT_WITHIN(2, rgb[2] >> 3, (px >> 3) & 0x1F);
+        }
+    }
+    free(ref);
+
+    TEST_ESP_OK(esp_lcd_st77912_mjpeg_del(player));
+    // the IO outlives the player, its callback must be gone (ASan flags the use after free otherwise)
+    mock_lcd_io_foreign_done(s_fx.io);
+    static uint16_t line[TEST_H_RES];
+    TEST_ESP_OK(esp_lcd_panel_draw_bitmap(s_fx.panel, 0, 0, TEST_H_RES, 1, line));
+    mock_lcd_io_wait_idle(s_fx.io);
+
+    free(clip);
+    free(color);
+    free(grey);
+    test_fixture_teardown(&s_fx);
+}
+
+static void test_last_band_failed(void)
+{
+    setup();
+    size_t grey_len;
+    uint8_t *grey = load_file("jpeg/grey.jpg", &grey_len);
+    uint8_t *clip = malloc(grey_len * 2);
+    memcpy(clip, grey, grey_len);
+    memcpy(clip + grey_len, grey, grey_len);
+    // every failed band is given up on right away
+    TEST_ESP_OK(esp_lcd_st77912_set_recovery(s_fx.panel, &(st77912_recovery_config_t) {
+        .max_tx_retries = 0,
+    }));
+
+    st77912_mjpeg_config_t config = ST77912_MJPEG_PLAYER_CONFIG(s_fx.panel, s_fx.io, 64, 25);
+    config.on_frame = on_frame;
+    st77912_mjpeg_handle_t player = NULL;
+    TEST_ESP_OK(esp_lcd_st77912_mjpeg_new(&config, &player));
+    mock_lcd_io_stats_t before;
+    mock_lcd_io_get_stats(s_fx.io, &before);
+    TEST_ESP_OK(esp_lcd_st77912_mjpeg_play(player, grey, grey_len));
+    mock_lcd_io_stats_t after;
+    mock_lcd_io_get_stats(s_fx.io, &after);
+    uint32_t bands = after.calls[MOCK_LCD_OP_TX_COLOR] - before.calls[MOCK_LCD_OP_TX_COLOR];
+    TEST_ASSERT_TRUE(bands > 1);
+    TEST_ASSERT_EQUAL(1, s_num_frames);
+    TEST_ASSERT_FALSE(s_frames[0].failed);
+
+    // the last band of the first frame never reaches the bus, both frames are still reported
+    s_num_frames = 0;
+    mock_lcd_io_fail(s_fx.io, MOCK_LCD_OP_TX_COLOR, bands, 1, ESP_FAIL);
+    TEST_ESP_ERR(ESP_FAIL, esp_lcd_st77912_mjpeg_play(player, clip, grey_len * 2));
+    TEST_ASSERT_EQUAL(2, s_num_frames);
+    TEST_ASSERT_EQUAL(0, s_frames[0].frame);
+    TEST_ASSERT_TRUE(s_frames[0].failed);
+    TEST_ASSERT_FALSE(s_frames[0].corrupt);
+    TEST_ASSERT_EQUAL(1, s_frames[1].frame);
+    TEST_ASSERT_FALSE(s_frames[1].failed);
+    mock_lcd_io_stats_t stats;
+    mock_lcd_io_get_stats(s_fx.io, &stats);
+    TEST_ASSERT_EQUAL(1, stats.failures[MOCK_LCD_OP_TX_COLOR]);
+
+    TEST_ESP_OK(esp_lcd_st77912_mjpeg_del(player));
+    free(clip);
+    free(grey);
+    test_fixture_teardown(&s_fx);
+}
+
+int main(void)
+{
+    host_clock_set_virtual(true);
+    RUN_TEST(test_corrupt_frames_skipped);
+    RUN_TEST(test_last_band_failed);
+    return 0;
+}
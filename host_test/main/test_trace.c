@@ -0,0 +1,145 @@
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_lcd_panel_ops.h"
+#include "esp_timer.h"
+#include "mock_lcd_panel.h"
+#include "test_fixture.h"
+#include "test_utils.h"
+
+#include "esp_lcd_st77912.h"
+
+// records a workload with every kind of call, checks the records and dumps them to argv[1] (RGB565) and argv[2]
+// (RGB666) for the replay_* tests, which run them through st77912_replay and expect the same bus traffic back
+
+#define TEST_TRACE_RECS             (512)
+
+static test_fixture_t s_fx;
+static st77912_trace_rec_t s_trace[TEST_TRACE_RECS];
+static const char *s_dump_paths[2];
+
+static void workload(void)
+{
+    // big enough for RGB666 too
+    static uint8_t pixels[TEST_H_RES * 40 * 3];
+
+    TEST_ESP_OK(esp_lcd_panel_reset(s_fx.panel));
+    TEST_ESP_OK(esp_lcd_panel_init(s_fx.panel));
+    TEST_ESP_OK(esp_lcd_panel_set_gap(s_fx.panel, 0, 20));
+    TEST_ESP_OK(esp_lcd_panel_mirror(s_fx.panel, true, false));
+    TEST_ESP_OK(esp_lcd_panel_swap_xy(s_fx.panel, false));
+    TEST_ESP_OK(esp_lcd_panel_invert_color(s_fx.panel, true));
+    TEST_ESP_OK(esp_lcd_panel_disp_on_off(s_fx.panel, true));
+    for (int frame = 0; frame < 3; frame++) {
+        for (int y = 0; y < 200; y += 40) {
+            TEST_ESP_OK(esp_lcd_panel_draw_bitmap(s_fx.panel, 0, y, TEST_H_RES, y + 40, pixels));
+        }
+        host_clock_advance(16 * 1000);
+    }
+    TEST_ESP_OK(esp_lcd_st77912_send_cmds(s_fx.panel, (const st77912_lcd_init_cmd_t []) {
+        {0xF0, (uint8_t []){0x01}, 1, 0},
+        {0xB1, (uint8_t []){0x12, 0x34, 0x56}, 3, 0},
+        {0xF0, (uint8_t []){0x00}, 1, 0},
+    }, 3));
+    TEST_ESP_OK(esp_lcd_st77912_check_health(s_fx.panel));
+    mock_lcd_panel_self_reset(s_fx.mock);
+    TEST_ESP_OK(esp_lcd_st77912_check_health(s_fx.panel));
+    TEST_ESP_OK(esp_lcd_panel_draw_bitmap(s_fx.panel, 10, 10, 20, 20, pixels));
+}
+
+static void record(int bits_per_pixel)
+{
+    // the workload resets and initializes the panel itself, under the trace
+    test_fixture_setup(&(test_fixture_config_t) {
+        .bits_per_pixel = bits_per_pixel,
+        .rgb_ele_order = LCD_RGB_ELEMENT_ORDER_BGR,
+        .no_init = true,
+    }, &s_fx);
+    TEST_ESP_OK(esp_lcd_st77912_trace_start(s_fx.panel, s_trace, sizeof(s_trace)));
+    workload();
+    TEST_ESP_OK(esp_lcd_st77912_trace_stop(s_fx.panel));
+}
+
+static void dump(const char *path)
+{
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    TEST_ASSERT_TRUE(saved >= 0 && fd >= 0);
+    dup2(fd, STDOUT_FILENO);
+    esp_err_t ret = esp_lcd_st77912_trace_dump(s_fx.panel);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(fd);
+    close(saved);
+    TEST_ESP_OK(ret);
+}
+
+static void test_trace_calls(void)
+{
+    record(16);
+
+    static st77912_trace_rec_t recs[TEST_TRACE_RECS];
+    size_t num = 0;
+    uint32_t dropped = 0;
+    TEST_ESP_OK(esp_lcd_st77912_trace_get(s_fx.panel, recs, TEST_TRACE_RECS, &num, &dropped));
+    TEST_ASSERT_EQUAL(0, dropped);
+    int calls[ST77912_TRACE_CALL_CHECK_HEALTH + 1] = {0};
+    int draws = 0;
+    for (size_t i = 0; i < num; i++) {
+        if (recs[i].type == ST77912_TRACE_CALL) {
+            TEST_ASSERT_TRUE(recs[i].cmd >= ST77912_TRACE_CALL_MIRROR && recs[i].cmd <= ST77912_TRACE_CALL_CHECK_HEALTH);
+            calls[recs[i].cmd]++;
+            if (recs[i].cmd == ST77912_TRACE_CALL_MIRROR) {
+                TEST_ASSERT_EQUAL(1, recs[i].data[0]);
+                TEST_ASSERT_EQUAL(0, recs[i].data[1]);
+            } else if (recs[i].cmd == ST77912_TRACE_CALL_SEND_CMDS) {
+                // the call, then its commands
+                TEST_ASSERT_EQUAL(3, recs[i].len);
+                TEST_ASSERT_EQUAL(ST77912_TRACE_PARAM, recs[i + 2].type);
+                TEST_ASSERT_EQUAL(0xB1, recs[i + 2].cmd);
+                TEST_ASSERT_EQUAL(0x56, recs[i + 2].data[2]);
+            }
+        } else if (recs[i].type == ST77912_TRACE_DRAW) {
+            draws++;
+        }
+    }
+    TEST_ASSERT_EQUAL(1, calls[ST77912_TRACE_CALL_MIRROR]);
+    TEST_ASSERT_EQUAL(1, calls[ST77912_TRACE_CALL_SWAP_XY]);
+    TEST_ASSERT_EQUAL(1, calls[ST77912_TRACE_CALL_INVERT]);
+    TEST_ASSERT_EQUAL(1, calls[ST77912_TRACE_CALL_DISP_ON_OFF]);
+    TEST_ASSERT_EQUAL(1, calls[ST77912_TRACE_CALL_SEND_CMDS]);
+    TEST_ASSERT_EQUAL(2, calls[ST77912_TRACE_CALL_CHECK_HEALTH]);
+    TEST_ASSERT_EQUAL(16, draws);
+
+    if (s_dump_paths[0]) {
+        dump(s_dump_paths[0]);
+    }
+    test_fixture_teardown(&s_fx);
+}
+
+static void test_trace_rgb666(void)
+{
+    record(18);
+    if (s_dump_paths[1]) {
+        dump(s_dump_paths[1]);
+        // the header carries the bpp the panel was configured with, which the replay passes on to the driver
+        char header[128] = {0};
+        FILE *f = fopen(s_dump_paths[1], "r");
+        TEST_ASSERT_TRUE(f && fgets(header, sizeof(header), f));
+        fclose(f);
+        TEST_ASSERT_TRUE(strstr(header, " bpp=18 "));
+    }
+    test_fixture_teardown(&s_fx);
+}
+
+int main(int argc, char **argv)
+{
+    host_clock_set_virtual(true);
+    s_dump_paths[0] = argc > 1 ? argv[1] : NULL;
+    s_dump_paths[1] = argc > 2 ? argv[2] : NULL;
+    RUN_TEST(test_trace_calls);
+    RUN_TEST(test_trace_rgb666);
+    return 0;
+}
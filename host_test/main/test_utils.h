@@ -0,0 +1,50 @@
+#pragma once
+
+// the handful of Unity assertions the tests use, so they read like the on-target tests do
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "esp_err.h"
+
+#define TEST_FAIL_MESSAGE(msg) do {                                                 \
+        fprintf(stderr, "%s:%d: FAIL: %s\n", __FILE__, __LINE__, msg);              \
+        exit(1);                                                                    \
+    } while (0)
+
+#define TEST_ASSERT_TRUE(cond) do {                                                 \
+        if (!(cond)) {                                                              \
+            TEST_FAIL_MESSAGE("expected " #cond);                                  \
+        }                                                                           \
+    } while (0)
+
+#define TEST_ASSERT_FALSE(cond)     TEST_ASSERT_TRUE(!(cond))
+
+#define TEST_ASSERT_EQUAL(expected, actual) do {                                    \
+        long long e_ = (long long)(expected);                                       \
+        long long a_ = (long long)(actual);                                         \
+        if (e_ != a_) {                                                             \
+            fprintf(stderr, "%s:%d: FAIL: %s expected %lld, was %lld\n",            \
+                    __FILE__, __LINE__, #actual, e_, a_);                           \
+            exit(1);                                                                \
+        }                                                                           \
+    } while (0)
+
+#define TEST_ASSERT_INT_WITHIN(delta, expected, actual) do {                        \
+        long long e_ = (long long)(expected);                                       \
+        long long a_ = (long long)(actual);                                         \
+        if (a_ < e_ - (delta) || a_ > e_ + (delta)) {                               \
+            fprintf(stderr, "%s:%d: FAIL: %s expected %lld +/- %lld, was %lld\n",   \
+                    __FILE__, __LINE__, #actual, e_, (long long)(delta), a_);       \
+            exit(1);                                                                \
+        }                                                                           \
+    } while (0)
+
+#define TEST_ESP_OK(x)              TEST_ASSERT_EQUAL(ESP_OK, (x))
+#define TEST_ESP_ERR(err, x)        TEST_ASSERT_EQUAL((err), (x))
+
+#define RUN_TEST(fn) do {                                                           \
+        printf("%s\n", #fn);                                                        \
+        fn();                                                                       \
+    } while (0)
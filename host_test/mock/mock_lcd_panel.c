@@ -0,0 +1,643 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/cdefs.h>
+
+#include "driver/spi_master.h"
+#include "esp_bit_defs.h"
+#include "esp_check.h"
+#include "esp_lcd_panel_commands.h"
+#include "esp_lcd_panel_io_interface.h"
+#include "esp_rom_crc.h"
+
+#include "mock_lcd_panel.h"
+
+#define MOCK_BUS_NUM                (8)
+#define MOCK_QUEUE_DEPTH_DEFAULT    (10)
+#define MOCK_SPI_SRC_CLK_HZ         (80 * 1000 * 1000)
+#define MOCK_RDDID                  {0x85, 0x85, 0x52}
+
+static const char *TAG = "mock_lcd";
+
+struct mock_lcd_panel_t {
+    pthread_mutex_t lock;
+    mock_lcd_panel_config_t config;
+    mock_lcd_panel_state_t state;
+    uint32_t *gram;
+    int ptr_x;
+    int ptr_y;
+};
+
+typedef struct {
+    int cmd;
+    const uint8_t *data;
+    size_t len;
+    uint32_t crc;
+} mock_lcd_pending_t;
+
+typedef struct {
+    esp_lcd_panel_io_t base;
+    mock_lcd_panel_t *panel;
+    uint32_t pclk_hz;
+    bool async;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t dma;
+    bool stopping;
+    bool hold;
+    int draining;
+    int calling;
+    mock_lcd_pending_t *pending;
+    size_t depth;
+    size_t head;
+    size_t num;
+    esp_lcd_panel_io_color_trans_done_cb_t cb;
+    void *cb_ctx;
+    uint32_t fail_at[MOCK_LCD_OP_MAX];
+    uint32_t fail_count[MOCK_LCD_OP_MAX];
+    esp_err_t fail_err[MOCK_LCD_OP_MAX];
+    mock_lcd_io_stats_t stats;
+    mock_lcd_txn_t *log;
+    size_t log_size;
+    size_t log_num;
+} mock_lcd_io_t;
+
+static mock_lcd_panel_t *s_bus_panels[MOCK_BUS_NUM];
+
+static void panel_reset_state(mock_lcd_panel_t *panel)
+{
+    panel->state.sleep_out = false;
+    panel->state.display_on = false;
+    panel->state.inverted = false;
+    panel->state.madctl = 0;
+    panel->state.colmod = 0x66;
+    panel->state.bank = 0;
+    panel->state.caset[0] = 0;
+    panel->state.caset[1] = panel->config.width - 1;
+    panel->state.raset[0] = 0;
+    panel->state.raset[1] = panel->config.height - 1;
+    panel->ptr_x = 0;
+    panel->ptr_y = 0;
+}
+
+esp_err_t mock_lcd_panel_new(const mock_lcd_panel_config_t *config, mock_lcd_panel_t **ret_panel)
+{
+    ESP_RETURN_ON_FALSE(config && ret_panel && config->width > 0 && config->height > 0, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    mock_lcd_panel_t *panel = calloc(1, sizeof(mock_lcd_panel_t));
+    ESP_RETURN_ON_FALSE(panel, ESP_ERR_NO_MEM, TAG, "no mem for mock panel");
+    panel->gram = calloc((size_t)config->width * config->height, sizeof(uint32_t));
+    if (!panel->gram) {
+        free(panel);
+        return ESP_ERR_NO_MEM;
+    }
+    panel->config = *config;
+    pthread_mutex_init(&panel->lock, NULL);
+    panel_reset_state(panel);
+    *ret_panel = panel;
+    return ESP_OK;
+}
+
+void mock_lcd_panel_del(mock_lcd_panel_t *panel)
+{
+    for (int i = 0; i < MOCK_BUS_NUM; i++) {
+        if (s_bus_panels[i] == panel) {
+            s_bus_panels[i] = NULL;
+        }
+    }
+    pthread_mutex_destroy(&panel->lock);
+    free(panel->gram);
+    free(panel);
+}
+
+void mock_lcd_panel_self_reset(mock_lcd_panel_t *panel)
+{
+    pthread_mutex_lock(&panel->lock);
+    panel_reset_state(panel);
+    memset(panel->gram, 0, (size_t)panel->config.width * panel->config.height * sizeof(uint32_t));
+    pthread_mutex_unlock(&panel->lock);
+}
+
+void mock_lcd_panel_get_state(mock_lcd_panel_t *panel, mock_lcd_panel_state_t *ret_state)
+{
+    pthread_mutex_lock(&panel->lock);
+    *ret_state = panel->state;
+    pthread_mutex_unlock(&panel->lock);
+}
+
+uint32_t mock_lcd_panel_get_pixel(mock_lcd_panel_t *panel, int x, int y)
+{
+    pthread_mutex_lock(&panel->lock);
+    uint32_t px = panel->gram[y * panel->config.width + x];
+    pthread_mutex_unlock(&panel->lock);
+    return px;
+}
+
+void mock_lcd_panel_attach_bus(esp_lcd_spi_bus_handle_t bus, mock_lcd_panel_t *panel)
+{
+    s_bus_panels[bus] = panel;
+}
+
+static int decode_cmd(int lcd_cmd)
+{
+    // QSPI puts an opcode in bits 31..24 and the command in bits 15..8
+    return (lcd_cmd & ~0xFF) ? (lcd_cmd >> 8) & 0xFF : lcd_cmd;
+}
+
+// a signal integrity problem rather than random noise, so a rerun at the same clock fails the same way
+static void corrupt(uint8_t *data, size_t len)
+{
+    for (size_t i = 3; i < len; i += 5) {
+        data[i] ^= 0x24;
+    }
+}
+
+static uint16_t be16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+// advance the GRAM pointer inside the CASET/RASET window
+static void panel_step(mock_lcd_panel_t *panel)
+{
+    mock_lcd_panel_state_t *st = &panel->state;
+    if (++panel->ptr_x > st->caset[1]) {
+        panel->ptr_x = st->caset[0];
+        if (++panel->ptr_y > st->raset[1]) {
+            panel->ptr_y = st->raset[0];
+        }
+    }
+}
+
+static uint32_t *panel_ptr(mock_lcd_panel_t *panel)
+{
+    if (panel->ptr_x >= panel->config.width || panel->ptr_y >= panel->config.height) {
+        return NULL;
+    }
+    return &panel->gram[panel->ptr_y * panel->config.width + panel->ptr_x];
+}
+
+static void panel_write_pixels(mock_lcd_panel_t *panel, const uint8_t *data, size_t len)
+{
+    bool rgb565 = (panel->state.colmod & 0x0F) == 0x05;
+    size_t bpp = rgb565 ? 2 : 3;
+    for (size_t i = 0; i + bpp <= len; i += bpp) {
+        uint32_t px = 0;
+        if (rgb565) {
+            uint16_t v = be16(&data[i]);
+            uint8_t r = (v >> 11) & 0x1F;
+            uint8_t g = (v >> 5) & 0x3F;
+            uint8_t b = v & 0x1F;
+            // 5-bit components are extended to 6 bits by repeating the MSB, as the controller does
+            px = (((r << 1) | (r >> 4)) << 18) | (g << 10) | (((b << 1) | (b >> 4)) << 2);
+        } else {
+            px = ((data[i] & 0xFC) << 16) | ((data[i + 1] & 0xFC) << 8) | (data[i + 2] & 0xFC);
+        }
+        uint32_t *dst = panel_ptr(panel);
+        if (dst) {
+            *dst = px;
+        }
+        panel->state.pixels_written++;
+        panel_step(panel);
+    }
+}
+
+static void panel_write(mock_lcd_panel_t *panel, int cmd, const uint8_t *data, size_t len)
+{
+    mock_lcd_panel_state_t *st = &panel->state;
+    pthread_mutex_lock(&panel->lock);
+    switch (cmd) {
+    case LCD_CMD_SWRESET:
+        panel_reset_state(panel);
+        st->swresets++;
+        break;
+    case LCD_CMD_SLPIN:
+        st->sleep_out = false;
+        break;
+    case LCD_CMD_SLPOUT:
+        st->sleep_out = true;
+        break;
+    case LCD_CMD_INVOFF:
+        st->inverted = false;
+        break;
+    case LCD_CMD_INVON:
+        st->inverted = true;
+        break;
+    case LCD_CMD_DISPOFF:
+        st->display_on = false;
+        break;
+    case LCD_CMD_DISPON:
+        st->display_on = true;
+        break;
+    case LCD_CMD_MADCTL:
+        if (len >= 1) {
+            st->madctl = data[0];
+        }
+        break;
+    case LCD_CMD_COLMOD:
+        if (len >= 1) {
+            st->colmod = data[0];
+        }
+        break;
+    case LCD_CMD_CASET:
+        if (len >= 4) {
+            st->caset[0] = be16(&data[0]);
+            st->caset[1] = be16(&data[2]);
+        }
+        break;
+    case LCD_CMD_RASET:
+        if (len >= 4) {
+            st->raset[0] = be16(&data[0]);
+            st->raset[1] = be16(&data[2]);
+        }
+        break;
+    case LCD_CMD_RAMWR:
+        panel->ptr_x = st->caset[0];
+        panel->ptr_y = st->raset[0];
+    // fall through
+    case LCD_CMD_RAMWRC:
+        panel_write_pixels(panel, data, len);
+        break;
+    case 0xF0:
+        if (len >= 1) {
+            st->bank = data[0];
+        }
+        break;
+    default:
+        // vendor registers, accepted and ignored
+        break;
+    }
+    pthread_mutex_unlock(&panel->lock);
+}
+
+static void panel_read(mock_lcd_panel_t *panel, int cmd, uint8_t *data, size_t len)
+{
+    mock_lcd_panel_state_t *st = &panel->state;
+    memset(data, 0, len);
+    if (panel->config.no_readback) {
+        return;
+    }
+    pthread_mutex_lock(&panel->lock);
+    switch (cmd) {
+    case LCD_CMD_RDDID: {
+        // one dummy byte, then ID1..ID3
+        const uint8_t id[] = MOCK_RDDID;
+        for (size_t i = 1; i < len && i <= sizeof(id); i++) {
+            data[i] = id[i - 1];
+        }
+        break;
+    }
+    case LCD_CMD_RDDST: {
+        uint32_t status = (st->sleep_out ? BIT(31) | BIT(17) : 0) | ((uint32_t)(st->madctl & 0xFC) << 23) |
+                          (st->inverted ? BIT(13) : 0) | (st->display_on ? BIT(10) : 0);
+        // one dummy clock ahead of D31, so the 32 status bits straddle five bytes
+        uint64_t raw = (uint64_t)status << 7;
+        for (size_t i = 0; i < len && i < 5; i++) {
+            data[i] = (raw >> (8 * (4 - i))) & 0xFF;
+        }
+        break;
+    }
+    case LCD_CMD_RAMRD:
+        // one dummy byte, then RGB666 whatever COLMOD says
+        panel->ptr_x = st->caset[0];
+        panel->ptr_y = st->raset[0];
+        for (size_t i = 1; i + 3 <= len; i += 3) {
+            uint32_t *src = panel_ptr(panel);
+            uint32_t px = src ? *src : 0;
+            data[i] = (px >> 16) & 0xFF;
+            data[i + 1] = (px >> 8) & 0xFF;
+            data[i + 2] = px & 0xFF;
+            panel_step(panel);
+        }
+        break;
+    default:
+        break;
+    }
+    pthread_mutex_unlock(&panel->lock);
+}
+
+static void io_log(mock_lcd_io_t *mio, mock_lcd_op_t op, int cmd, const void *data, size_t len)
+{
+    if (mio->log_num == mio->log_size) {
+        return;
+    }
+    mock_lcd_txn_t *txn = &mio->log[mio->log_num++];
+    memset(txn, 0, sizeof(*txn));
+    txn->op = op;
+    txn->cmd = cmd;
+    txn->len = len;
+    if (data && op != MOCK_LCD_OP_RX_PARAM) {
+        txn->crc = esp_rom_crc32_le(0, data, len);
+        memcpy(txn->data, data, len < sizeof(txn->data) ? len : sizeof(txn->data));
+    }
+}
+
+// count the call, and tell whether an injected fault hits it
+static esp_err_t io_enter(mock_lcd_io_t *mio, mock_lcd_op_t op)
+{
+    uint32_t n = ++mio->stats.calls[op];
+    if (mio->fail_count[op] && n >= mio->fail_at[op]) {
+        mio->fail_count[op]--;
+        mio->stats.failures[op]++;
+        return mio->fail_err[op];
+    }
+    return ESP_OK;
+}
+
+// called with the lock held, which is dropped around the callback like an ISR wouldn't hold it
+static void io_fire_cb(mock_lcd_io_t *mio)
+{
+    esp_lcd_panel_io_color_trans_done_cb_t cb = mio->cb;
+    void *ctx = mio->cb_ctx;
+    if (!cb) {
+        return;
+    }
+    mio->calling++;
+    pthread_mutex_unlock(&mio->lock);
+    esp_lcd_panel_io_event_data_t edata = {};
+    cb(&mio->base, &edata, ctx);
+    pthread_mutex_lock(&mio->lock);
+    mio->calling--;
+    pthread_cond_broadcast(&mio->changed);
+}
+
+static void io_complete(mock_lcd_io_t *mio, int cmd, const uint8_t *data, size_t len, uint32_t crc)
+{
+    if (mio->panel) {
+        uint8_t *copy = malloc(len ? len : 1);
+        memcpy(copy, data, len);
+        if (mio->panel->config.max_write_hz && mio->pclk_hz > mio->panel->config.max_write_hz) {
+            corrupt(copy, len);
+        }
+        panel_write(mio->panel, cmd, copy, len);
+        free(copy);
+    }
+    if (len && esp_rom_crc32_le(0, data, len) != crc) {
+        mio->stats.inflight_modified++;
+    }
+    mio->stats.completions++;
+}
+
+static void io_complete_head(mock_lcd_io_t *mio)
+{
+    mock_lcd_pending_t txn = mio->pending[mio->head];
+    mio->head = (mio->head + 1) % mio->depth;
+    io_complete(mio, txn.cmd, txn.data, txn.len, txn.crc);
+    // the slot is freed once the data is out, the callback runs after that as on the target
+    mio->num--;
+    pthread_cond_broadcast(&mio->changed);
+    io_fire_cb(mio);
+}
+
+static void *io_dma_task(void *arg)
+{
+    mock_lcd_io_t *mio = arg;
+    pthread_mutex_lock(&mio->lock);
+    while (!mio->stopping || mio->num) {
+        if (mio->num && (!mio->hold || mio->draining || mio->stopping)) {
+            io_complete_head(mio);
+        } else {
+            pthread_cond_wait(&mio->changed, &mio->lock);
+        }
+    }
+    pthread_mutex_unlock(&mio->lock);
+    return NULL;
+}
+
+// IDF queues a transaction's result after its post callback, so a drain also waits for the callback to return
+static void io_drain(mock_lcd_io_t *mio)
+{
+    mio->draining++;
+    pthread_cond_broadcast(&mio->changed);
+    while (mio->num || mio->calling) {
+        pthread_cond_wait(&mio->changed, &mio->lock);
+    }
+    mio->draining--;
+}
+
+static esp_err_t mock_io_tx_param(esp_lcd_panel_io_t *io, int lcd_cmd, const void *param, size_t param_size)
+{
+    mock_lcd_io_t *mio = __containerof(io, mock_lcd_io_t, base);
+    int cmd = decode_cmd(lcd_cmd);
+    pthread_mutex_lock(&mio->lock);
+    io_drain(mio);
+    esp_err_t ret = io_enter(mio, MOCK_LCD_OP_TX_PARAM);
+    if (ret == ESP_OK) {
+        io_log(mio, MOCK_LCD_OP_TX_PARAM, cmd, param, param_size);
+        if (mio->panel) {
+            panel_write(mio->panel, cmd, param, param_size);
+        }
+    }
+    pthread_mutex_unlock(&mio->lock);
+    return ret;
+}
+
+static esp_err_t mock_io_rx_param(esp_lcd_panel_io_t *io, int lcd_cmd, void *param, size_t param_size)
+{
+    mock_lcd_io_t *mio = __containerof(io, mock_lcd_io_t, base);
+    int cmd = decode_cmd(lcd_cmd);
+    pthread_mutex_lock(&mio->lock);
+    io_drain(mio);
+    esp_err_t ret = io_enter(mio, MOCK_LCD_OP_RX_PARAM);
+    if (ret == ESP_OK) {
+        io_log(mio, MOCK_LCD_OP_RX_PARAM, cmd, NULL, param_size);
+        if (mio->panel) {
+            panel_read(mio->panel, cmd, param, param_size);
+            if (mio->panel->config.max_read_hz && mio->pclk_hz > mio->panel->config.max_read_hz) {
+                corrupt(param, param_size);
+            }
+        } else {
+            memset(param, 0, param_size);
+        }
+    }
+    pthread_mutex_unlock(&mio->lock);
+    return ret;
+}
+
+static esp_err_t mock_io_tx_color(esp_lcd_panel_io_t *io, int lcd_cmd, const void *color, size_t color_size)
+{
+    mock_lcd_io_t *mio = __containerof(io, mock_lcd_io_t, base);
+    int cmd = decode_cmd(lcd_cmd);
+    pthread_mutex_lock(&mio->lock);
+    esp_err_t ret = io_enter(mio, MOCK_LCD_OP_TX_COLOR);
+    if (ret != ESP_OK) {
+        pthread_mutex_unlock(&mio->lock);
+        return ret;
+    }
+    io_log(mio, MOCK_LCD_OP_TX_COLOR, cmd, color, color_size);
+    mio->stats.color_bytes += color_size;
+    uint32_t crc = color_size ? esp_rom_crc32_le(0, color, color_size) : 0;
+    if (!mio->async) {
+        if (mio->stats.max_inflight < 1) {
+            mio->stats.max_inflight = 1;
+        }
+        io_complete(mio, cmd, color, color_size, crc);
+        io_fire_cb(mio);
+        pthread_mutex_unlock(&mio->lock);
+        return ESP_OK;
+    }
+    while (mio->num == mio->depth) {
+        pthread_cond_wait(&mio->changed, &mio->lock);
+    }
+    mio->pending[(mio->head + mio->num) % mio->depth] = (mock_lcd_pending_t) {
+        .cmd = cmd,
+        .data = color,
+        .len = color_size,
+        .crc = crc,
+    };
+    mio->num++;
+    if (mio->num > mio->stats.max_inflight) {
+        mio->stats.max_inflight = mio->num;
+    }
+    pthread_cond_broadcast(&mio->changed);
+    pthread_mutex_unlock(&mio->lock);
+    return ESP_OK;
+}
+
+static esp_err_t mock_io_register_event_callbacks(esp_lcd_panel_io_t *io, const esp_lcd_panel_io_callbacks_t *cbs, void *user_ctx)
+{
+    mock_lcd_io_t *mio = __containerof(io, mock_lcd_io_t, base);
+    pthread_mutex_lock(&mio->lock);
+    // don't swap the callback under one that is running, unless it's the callback itself doing this
+    while (mio->calling && !(mio->async && pthread_equal(pthread_self(), mio->dma))) {
+        pthread_cond_wait(&mio->changed, &mio->lock);
+    }
+    mio->cb = cbs->on_color_trans_done;
+    mio->cb_ctx = user_ctx;
+    pthread_mutex_unlock(&mio->lock);
+    return ESP_OK;
+}
+
+static esp_err_t mock_io_del(esp_lcd_panel_io_t *io)
+{
+    mock_lcd_io_t *mio = __containerof(io, mock_lcd_io_t, base);
+    if (mio->async) {
+        pthread_mutex_lock(&mio->lock);
+        mio->stopping = true;
+        pthread_cond_broadcast(&mio->changed);
+        pthread_mutex_unlock(&mio->lock);
+        pthread_join(mio->dma, NULL);
+    }
+    pthread_cond_destroy(&mio->changed);
+    pthread_mutex_destroy(&mio->lock);
+    free(mio->pending);
+    free(mio->log);
+    free(mio);
+    return ESP_OK;
+}
+
+esp_err_t mock_lcd_io_new(mock_lcd_panel_t *panel, const mock_lcd_io_config_t *config, esp_lcd_panel_io_handle_t *ret_io)
+{
+    ESP_RETURN_ON_FALSE(config && ret_io, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    mock_lcd_io_t *mio = calloc(1, sizeof(mock_lcd_io_t));
+    ESP_RETURN_ON_FALSE(mio, ESP_ERR_NO_MEM, TAG, "no mem for mock io");
+    mio->depth = config->queue_depth ? config->queue_depth : MOCK_QUEUE_DEPTH_DEFAULT;
+    mio->pending = calloc(mio->depth, sizeof(mock_lcd_pending_t));
+    mio->log_size = config->log_size;
+    mio->log = config->log_size ? calloc(config->log_size, sizeof(mock_lcd_txn_t)) : NULL;
+    if (!mio->pending || (config->log_size && !mio->log)) {
+        free(mio->pending);
+        free(mio->log);
+        free(mio);
+        return ESP_ERR_NO_MEM;
+    }
+    mio->panel = panel;
+    mio->pclk_hz = config->pclk_hz;
+    mio->async = config->async;
+    mio->cb = config->on_color_trans_done;
+    mio->cb_ctx = config->user_ctx;
+    pthread_mutex_init(&mio->lock, NULL);
+    pthread_cond_init(&mio->changed, NULL);
+    mio->base.rx_param = mock_io_rx_param;
+    mio->base.tx_param = mock_io_tx_param;
+    mio->base.tx_color = mock_io_tx_color;
+    mio->base.del = mock_io_del;
+    mio->base.register_event_callbacks = mock_io_register_event_callbacks;
+    if (mio->async) {
+        pthread_create(&mio->dma, NULL, io_dma_task, mio);
+    }
+    *ret_io = &mio->base;
+    return ESP_OK;
+}
+
+void mock_lcd_io_fail(esp_lcd_panel_io_handle_t io, mock_lcd_op_t op, uint32_t nth, uint32_t count, esp_err_t err)
+{
+    mock_lcd_io_t *mio = __containerof(io, mock_lcd_io_t, base);
+    pthread_mutex_lock(&mio->lock);
+    mio->fail_at[op] = mio->stats.calls[op] + nth;
+    mio->fail_count[op] = count;
+    mio->fail_err[op] = err;
+    pthread_mutex_unlock(&mio->lock);
+}
+
+void mock_lcd_io_hold(esp_lcd_panel_io_handle_t io, bool hold)
+{
+    mock_lcd_io_t *mio = __containerof(io, mock_lcd_io_t, base);
+    pthread_mutex_lock(&mio->lock);
+    mio->hold = hold;
+    pthread_cond_broadcast(&mio->changed);
+    pthread_mutex_unlock(&mio->lock);
+}
+
+void mock_lcd_io_wait_idle(esp_lcd_panel_io_handle_t io)
+{
+    mock_lcd_io_t *mio = __containerof(io, mock_lcd_io_t, base);
+    pthread_mutex_lock(&mio->lock);
+    while (mio->num || mio->calling) {
+        pthread_cond_wait(&mio->changed, &mio->lock);
+    }
+    pthread_mutex_unlock(&mio->lock);
+}
+
+uint32_t mock_lcd_io_inflight(esp_lcd_panel_io_handle_t io)
+{
+    mock_lcd_io_t *mio = __containerof(io, mock_lcd_io_t, base);
+    pthread_mutex_lock(&mio->lock);
+    uint32_t num = mio->num;
+    pthread_mutex_unlock(&mio->lock);
+    return num;
+}
+
+void mock_lcd_io_foreign_done(esp_lcd_panel_io_handle_t io)
+{
+    mock_lcd_io_t *mio = __containerof(io, mock_lcd_io_t, base);
+    pthread_mutex_lock(&mio->lock);
+    io_fire_cb(mio);
+    pthread_mutex_unlock(&mio->lock);
+}
+
+void mock_lcd_io_get_stats(esp_lcd_panel_io_handle_t io, mock_lcd_io_stats_t *ret_stats)
+{
+    mock_lcd_io_t *mio = __containerof(io, mock_lcd_io_t, base);
+    pthread_mutex_lock(&mio->lock);
+    *ret_stats = mio->stats;
+    pthread_mutex_unlock(&mio->lock);
+}
+
+const mock_lcd_txn_t *mock_lcd_io_get_log(esp_lcd_panel_io_handle_t io, size_t *ret_num)
+{
+    mock_lcd_io_t *mio = __containerof(io, mock_lcd_io_t, base);
+    pthread_mutex_lock(&mio->lock);
+    *ret_num = mio->log_num;
+    pthread_mutex_unlock(&mio->lock);
+    return mio->log;
+}
+
+void mock_lcd_io_clear_log(esp_lcd_panel_io_handle_t io)
+{
+    mock_lcd_io_t *mio = __containerof(io, mock_lcd_io_t, base);
+    pthread_mutex_lock(&mio->lock);
+    mio->log_num = 0;
+    pthread_mutex_unlock(&mio->lock);
+}
+
+esp_err_t esp_lcd_new_panel_io_spi(esp_lcd_spi_bus_handle_t bus, const esp_lcd_panel_io_spi_config_t *io_config, esp_lcd_panel_io_handle_t *ret_io)
+{
+    ESP_RETURN_ON_FALSE(io_config && ret_io && bus >= 0 && bus < MOCK_BUS_NUM && s_bus_panels[bus], ESP_ERR_INVALID_ARG,
+                        TAG, "no mock panel on this bus");
+    mock_lcd_io_config_t config = {
+        .pclk_hz = spi_get_actual_clock(MOCK_SPI_SRC_CLK_HZ, io_config->pclk_hz, 128),
+        .on_color_trans_done = io_config->on_color_trans_done,
+        .user_ctx = io_config->user_ctx,
+    };
+    return mock_lcd_io_new(s_bus_panels[bus], &config, ret_io);
+}
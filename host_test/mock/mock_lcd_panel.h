@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_lcd_panel_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A model of the ST77912 controller behind a panel IO: GRAM (stored as RGB666, 0x00RRGGBB with the
+ * 6 bits of each component left-aligned), the DCS state RDDST reports, and clock limits above which
+ * pixel data gets corrupted on the way in or out. GRAM addressing ignores MADCTL.
+ */
+typedef struct mock_lcd_panel_t mock_lcd_panel_t;
+
+typedef struct {
+    int width;
+    int height;
+    uint32_t max_write_hz;      // pixel data written faster than this is corrupted, 0 for no limit
+    uint32_t max_read_hz;       // data read faster than this is corrupted, 0 for no limit
+    bool no_readback;           // MISO not wired, reads return the idle level
+} mock_lcd_panel_config_t;
+
+typedef struct {
+    bool sleep_out;
+    bool display_on;
+    bool inverted;
+    uint8_t madctl;
+    uint8_t colmod;
+    uint8_t bank;               // last F0h parameter
+    uint16_t caset[2];
+    uint16_t raset[2];
+    uint32_t swresets;
+    uint32_t pixels_written;
+} mock_lcd_panel_state_t;
+
+esp_err_t mock_lcd_panel_new(const mock_lcd_panel_config_t *config, mock_lcd_panel_t **ret_panel);
+
+void mock_lcd_panel_del(mock_lcd_panel_t *panel);
+
+// the controller resets itself (ESD, brown-out): registers back to their reset values, GRAM cleared
+void mock_lcd_panel_self_reset(mock_lcd_panel_t *panel);
+
+void mock_lcd_panel_get_state(mock_lcd_panel_t *panel, mock_lcd_panel_state_t *ret_state);
+
+uint32_t mock_lcd_panel_get_pixel(mock_lcd_panel_t *panel, int x, int y);
+
+// panel IOs that esp_lcd_new_panel_io_spi() creates on bus talk to panel, synchronously
+void mock_lcd_panel_attach_bus(esp_lcd_spi_bus_handle_t bus, mock_lcd_panel_t *panel);
+
+typedef enum {
+    MOCK_LCD_OP_TX_PARAM,
+    MOCK_LCD_OP_TX_COLOR,
+    MOCK_LCD_OP_RX_PARAM,
+    MOCK_LCD_OP_MAX,
+} mock_lcd_op_t;
+
+typedef struct {
+    uint32_t pclk_hz;
+    bool async;                 // color transfers complete on a separate "DMA" thread, like SPI with queued transactions
+    size_t queue_depth;         // in-flight color transfers before tx_color blocks, async only, 10 if 0
+    size_t log_size;            // the first log_size transactions are logged, 0 for no log
+    esp_lcd_panel_io_color_trans_done_cb_t on_color_trans_done;
+    void *user_ctx;
+} mock_lcd_io_config_t;
+
+typedef struct {
+    uint32_t calls[MOCK_LCD_OP_MAX];
+    uint32_t failures[MOCK_LCD_OP_MAX];
+    uint64_t color_bytes;
+    uint32_t completions;       // color transfers done, the callback (if any) ran for each
+    uint32_t inflight_modified; // color buffers changed by the caller before their transfer completed
+    uint32_t max_inflight;
+} mock_lcd_io_stats_t;
+
+typedef struct {
+    mock_lcd_op_t op;
+    int cmd;                    // DCS command, the QSPI opcode stripped
+    uint32_t len;
+    uint32_t crc;               // of all len bytes (tx only)
+    uint8_t data[8];            // first bytes (tx only)
+} mock_lcd_txn_t;
+
+/**
+ * A panel IO on panel, NULL panel for one that only logs and counts. Delete it with esp_lcd_panel_io_del().
+ */
+esp_err_t mock_lcd_io_new(mock_lcd_panel_t *panel, const mock_lcd_io_config_t *config, esp_lcd_panel_io_handle_t *ret_io);
+
+// starting with the nth next call of op (1 = the next one), count calls return err without reaching the panel
+void mock_lcd_io_fail(esp_lcd_panel_io_handle_t io, mock_lcd_op_t op, uint32_t nth, uint32_t count, esp_err_t err);
+
+/**
+ * Hold async color transfers in flight. A command or read still drains them first, as the SPI driver does,
+ * releasing the hold starts completing the rest.
+ */
+void mock_lcd_io_hold(esp_lcd_panel_io_handle_t io, bool hold);
+
+// wait until no color transfer is in flight, the hold is not overridden
+void mock_lcd_io_wait_idle(esp_lcd_panel_io_handle_t io);
+
+uint32_t mock_lcd_io_inflight(esp_lcd_panel_io_handle_t io);
+
+// complete a color transfer that wasn't queued through this IO (another user of the bus), fires the callback
+void mock_lcd_io_foreign_done(esp_lcd_panel_io_handle_t io);
+
+void mock_lcd_io_get_stats(esp_lcd_panel_io_handle_t io, mock_lcd_io_stats_t *ret_stats);
+
+// the logged transactions, oldest first, valid until the next IO call
+const mock_lcd_txn_t *mock_lcd_io_get_log(esp_lcd_panel_io_handle_t io, size_t *ret_num);
+
+void mock_lcd_io_clear_log(esp_lcd_panel_io_handle_t io);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "esp_check.h"
+#include "esp_lcd_panel_ops.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mock_lcd_panel.h"
+
+#include "esp_lcd_st77912.h"
+
+// Re-drive the API calls of a trace dump (draws, gaps, mirror/swap/invert/display, send_cmds, health checks)
+// through this build of the driver against the mock panel IO, and dump the trace the driver records while
+// doing so. The bus traffic in the input only serves as the reference, tools/st77912_trace.py compares both:
+//   st77912_replay monitor.log [pclk_hz] > replayed.log
+
+#define REPLAY_MAX_LINE             (256)
+#define REPLAY_DEFAULT_PCLK_HZ      (40 * 1000 * 1000)
+#define REPLAY_RESET_GPIO           (9)
+
+static const char *TAG = "st77912_replay";
+
+typedef struct {
+    int bpp;
+    bool qspi;
+    bool bgr;
+    bool hwreset;
+    st77912_trace_rec_t *recs;
+    int64_t *ts_us;             // unwrapped timestamps, relative to the first record
+    size_t num;
+} replay_trace_t;
+
+static int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static bool parse_rec(const char *hex, st77912_trace_rec_t *rec)
+{
+    uint8_t *out = (uint8_t *)rec;
+    for (size_t i = 0; i < sizeof(*rec); i++) {
+        int hi = hex_nibble(hex[i * 2]);
+        int lo = hex_nibble(hex[i * 2 + 1]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        out[i] = (hi << 4) | lo;
+    }
+    return true;
+}
+
+static int header_field(const char *header, const char *key, int def)
+{
+    const char *p = strstr(header, key);
+    return p ? atoi(p + strlen(key)) : def;
+}
+
+// the last dump in the log wins, like in st77912_trace.py
+static esp_err_t load_trace(const char *path, replay_trace_t *trace)
+{
+    memset(trace, 0, sizeof(*trace));
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        ESP_LOGE(TAG, "cannot open %s", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+    size_t cap = 0;
+    char line[REPLAY_MAX_LINE];
+    while (fgets(line, sizeof(line), f)) {
+        const char *p = strstr(line, "ST77912TRACE ");
+        if (!p) {
+            continue;
+        }
+        p += strlen("ST77912TRACE ");
+        if (p[0] == 'v') {
+            trace->bpp = header_field(p, "bpp=", 16);
+            if (trace->bpp == 24) {
+                // dumps from before the header carried the configured bpp, RGB666 in 3 bytes
+                trace->bpp = 18;
+            }
+            trace->qspi = header_field(p, "qspi=", 0);
+            trace->bgr = header_field(p, "bgr=", 0);
+            trace->hwreset = header_field(p, "hwreset=", 0);
+            trace->num = 0;
+            continue;
+        }
+        st77912_trace_rec_t rec;
+        if (!parse_rec(p, &rec)) {
+            continue;
+        }
+        if (trace->num == cap) {
+            cap = cap ? cap * 2 : 1024;
+            trace->recs = realloc(trace->recs, cap * sizeof(st77912_trace_rec_t));
+            trace->ts_us = realloc(trace->ts_us, cap * sizeof(int64_t));
+            if (!trace->recs || !trace->ts_us) {
+                fclose(f);
+                return ESP_ERR_NO_MEM;
+            }
+        }
+        trace->recs[trace->num++] = rec;
+    }
+    fclose(f);
+    if (!trace->num) {
+        ESP_LOGE(TAG, "%s: no ST77912TRACE records found", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // timestamps are the low 32 bits of esp_timer, unwrap them
+    int64_t base = 0;
+    for (size_t i = 0; i < trace->num; i++) {
+        if (i && trace->recs[i].timestamp_us < trace->recs[i - 1].timestamp_us) {
+            base += 1LL << 32;
+        }
+        trace->ts_us[i] = base + trace->recs[i].timestamp_us - trace->recs[0].timestamp_us;
+    }
+    return ESP_OK;
+}
+
+// the panel has to cover every window drawn, in either orientation
+static int panel_size(const replay_trace_t *trace)
+{
+    int size = 1;
+    int16_t gap[2] = {0};
+    for (size_t i = 0; i < trace->num; i++) {
+        const st77912_trace_rec_t *rec = &trace->recs[i];
+        if (rec->type == ST77912_TRACE_GAP) {
+            memcpy(gap, rec->data, sizeof(gap));
+        } else if (rec->type == ST77912_TRACE_DRAW) {
+            int16_t area[4];
+            memcpy(area, rec->data, sizeof(area));
+            size = MAX(size, MAX(area[2], area[3]) + MAX(gap[0], gap[1]));
+        }
+    }
+    return size;
+}
+
+// a fast re-init recorded before the next call means the panel had reset itself when the health check ran
+static bool health_check_recovered(const replay_trace_t *trace, size_t i)
+{
+    for (i++; i < trace->num; i++) {
+        const st77912_trace_rec_t *rec = &trace->recs[i];
+        if (rec->type == ST77912_TRACE_INIT) {
+            return rec->cmd == 1;
+        }
+        if (rec->type == ST77912_TRACE_CALL || rec->type == ST77912_TRACE_DRAW || rec->type == ST77912_TRACE_RESET) {
+            return false;
+        }
+    }
+    return false;
+}
+
+// the PARAM records after the call are its commands, the main loop skips them like any other bus traffic
+static esp_err_t send_cmds(esp_lcd_panel_handle_t panel, const replay_trace_t *trace, size_t i)
+{
+    uint16_t num = trace->recs[i].len;
+    st77912_lcd_init_cmd_t *cmds = calloc(MAX(num, 1), sizeof(st77912_lcd_init_cmd_t));
+    ESP_RETURN_ON_FALSE(cmds, ESP_ERR_NO_MEM, TAG, "no mem for commands");
+    esp_err_t ret = ESP_OK;
+    uint16_t found = 0;
+    for (size_t j = i + 1; j < trace->num && found < num; j++) {
+        const st77912_trace_rec_t *rec = &trace->recs[j];
+        if (rec->type != ST77912_TRACE_PARAM) {
+            continue;
+        }
+        // records keep 8 parameter bytes, longer commands go out zero-padded
+        uint8_t *data = calloc(MAX(rec->len, 1), 1);
+        ESP_GOTO_ON_FALSE(data, ESP_ERR_NO_MEM, out, TAG, "no mem for parameters");
+        memcpy(data, rec->data, MIN(rec->len, sizeof(rec->data)));
+        if (rec->len > sizeof(rec->data)) {
+            ESP_LOGW(TAG, "command %02Xh has %d parameter bytes, only 8 were recorded", rec->cmd, rec->len);
+        }
+        cmds[found++] = (st77912_lcd_init_cmd_t) {
+            rec->cmd, data, rec->len, 0
+        };
+    }
+    ret = esp_lcd_st77912_send_cmds(panel, cmds, found);
+out:
+    for (uint16_t k = 0; k < found; k++) {
+        free((void *)cmds[k].data);
+    }
+    free(cmds);
+    return ret;
+}
+
+static esp_err_t replay_call(esp_lcd_panel_handle_t panel, mock_lcd_panel_t *mock, const replay_trace_t *trace, size_t i)
+{
+    const st77912_trace_rec_t *rec = &trace->recs[i];
+    switch (rec->cmd) {
+    case ST77912_TRACE_CALL_MIRROR:
+        return esp_lcd_panel_mirror(panel, rec->data[0], rec->data[1]);
+    case ST77912_TRACE_CALL_SWAP_XY:
+        return esp_lcd_panel_swap_xy(panel, rec->data[0]);
+    case ST77912_TRACE_CALL_INVERT:
+        return esp_lcd_panel_invert_color(panel, rec->data[0]);
+    case ST77912_TRACE_CALL_DISP_ON_OFF:
+        return esp_lcd_panel_disp_on_off(panel, rec->data[0]);
+    case ST77912_TRACE_CALL_SEND_CMDS:
+        return send_cmds(panel, trace, i);
+    case ST77912_TRACE_CALL_CHECK_HEALTH:
+        if (health_check_recovered(trace, i)) {
+            mock_lcd_panel_self_reset(mock);
+        }
+        return esp_lcd_st77912_check_health(panel);
+    default:
+        ESP_LOGW(TAG, "unknown call %d skipped", rec->cmd);
+        return ESP_OK;
+    }
+}
+
+static esp_err_t replay(const replay_trace_t *trace, uint32_t pclk_hz)
+{
+    int size = panel_size(trace);
+    mock_lcd_panel_config_t mock_config = {
+        .width = size,
+        .height = size,
+    };
+    mock_lcd_panel_t *mock = NULL;
+    ESP_RETURN_ON_ERROR(mock_lcd_panel_new(&mock_config, &mock), TAG, "create mock panel failed");
+    mock_lcd_io_config_t io_config = {
+        .pclk_hz = pclk_hz,
+    };
+    esp_lcd_panel_io_handle_t io = NULL;
+    ESP_RETURN_ON_ERROR(mock_lcd_io_new(mock, &io_config, &io), TAG, "create mock IO failed");
+    st77912_vendor_config_t vendor_config = {
+        .flags.use_qspi_interface = trace->qspi,
+    };
+    esp_lcd_panel_dev_config_t panel_config = {
+        .reset_gpio_num = trace->hwreset ? REPLAY_RESET_GPIO : -1,
+        .rgb_ele_order = trace->bgr ? LCD_RGB_ELEMENT_ORDER_BGR : LCD_RGB_ELEMENT_ORDER_RGB,
+        .bits_per_pixel = trace->bpp,
+        .vendor_config = &vendor_config,
+    };
+    esp_lcd_panel_handle_t panel = NULL;
+    ESP_RETURN_ON_ERROR(esp_lcd_new_panel_st77912(io, &panel_config, &panel), TAG, "create panel failed");
+
+    // room for a driver that sends a lot more than the recorded one
+    size_t trace_size = (trace->num * 4 + 1024) * sizeof(st77912_trace_rec_t);
+    void *trace_buf = malloc(trace_size);
+    // RGB666 takes a full byte per component in the frame buffer
+    uint8_t *pixels = calloc((size_t)size * size, trace->bpp == 18 ? 3 : 2);
+    ESP_RETURN_ON_FALSE(trace_buf && pixels, ESP_ERR_NO_MEM, TAG, "no mem for replay buffers");
+    ESP_RETURN_ON_ERROR(esp_lcd_st77912_trace_start(panel, trace_buf, trace_size), TAG, "start trace failed");
+
+    int failed = 0;
+    for (size_t i = 0; i < trace->num; i++) {
+        const st77912_trace_rec_t *rec = &trace->recs[i];
+        // calls start when they did on the target, waits inside the driver run on from there
+        if (esp_timer_get_time() < trace->ts_us[i]) {
+            host_clock_set(trace->ts_us[i]);
+        }
+        esp_err_t ret = ESP_OK;
+        switch (rec->type) {
+        case ST77912_TRACE_RESET:
+            ret = esp_lcd_panel_reset(panel);
+            break;
+        case ST77912_TRACE_INIT:
+            // the fast re-init comes from the health check that is replayed with it
+            if (!rec->cmd) {
+                ret = esp_lcd_panel_init(panel);
+            }
+            break;
+        case ST77912_TRACE_GAP: {
+            int16_t gap[2];
+            memcpy(gap, rec->data, sizeof(gap));
+            ret = esp_lcd_panel_set_gap(panel, gap[0], gap[1]);
+            break;
+        }
+        case ST77912_TRACE_DRAW: {
+            int16_t area[4];
+            memcpy(area, rec->data, sizeof(area));
+            if (area[0] < area[2] && area[1] < area[3]) {
+                ret = esp_lcd_panel_draw_bitmap(panel, area[0], area[1], area[2], area[3], pixels);
+            }
+            break;
+        }
+        case ST77912_TRACE_CALL:
+            ret = replay_call(panel, mock, trace, i);
+            break;
+        default:
+            // bus traffic of the recorded driver, this one produces its own
+            break;
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "record %zu (type %d) failed: %s", i, rec->type, esp_err_to_name(ret));
+            failed++;
+        }
+    }
+
+    esp_lcd_st77912_trace_stop(panel);
+    esp_lcd_st77912_trace_dump(panel);
+    esp_lcd_panel_del(panel);
+    esp_lcd_panel_io_del(io);
+    mock_lcd_panel_del(mock);
+    free(pixels);
+    free(trace_buf);
+    return failed ? ESP_FAIL : ESP_OK;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s LOG [pclk_hz]\n", argv[0]);
+        return 2;
+    }
+    uint32_t pclk_hz = argc > 2 ? strtoul(argv[2], NULL, 0) : REPLAY_DEFAULT_PCLK_HZ;
+
+    host_clock_set_virtual(true);
+    host_clock_set(0);
+    replay_trace_t trace;
+    esp_err_t ret = load_trace(argv[1], &trace);
+    if (ret == ESP_OK) {
+        ret = replay(&trace, pclk_hz);
+    }
+    free(trace.recs);
+    free(trace.ts_us);
+    return ret == ESP_OK ? 0 : 1;
+}
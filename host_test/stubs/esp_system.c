@@ -0,0 +1,271 @@
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "driver/gpio.h"
+#include "driver/spi_master.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+#define HOST_GPIO_NUM               (64)
+#define HOST_NVS_MAX                (16)
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_NOT_ENOUGH_SPACE: return "ESP_ERR_NVS_NOT_ENOUGH_SPACE";
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+void host_esp_error_check_failed(esp_err_t rc, const char *file, int line, const char *function, const char *expression)
+{
+    fprintf(stderr, "ESP_ERROR_CHECK failed: esp_err_t 0x%x (%s) at %s:%d in %s(): %s\n",
+            rc, esp_err_to_name(rc), file, line, function, expression);
+    abort();
+}
+
+void host_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static int max_level = -1;
+    if (max_level < 0) {
+        const char *env = getenv("HOST_LOG_LEVEL");
+        max_level = env ? atoi(env) : ESP_LOG_NONE;
+    }
+    if ((int)level > max_level) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%c (%s) ", "NEWIDV"[level], tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+static pthread_mutex_t s_clock_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool s_clock_virtual;
+static int64_t s_clock_us;
+
+static int64_t monotonic_us(void)
+{
+    static int64_t start_us = -1;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t now = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    if (start_us < 0) {
+        start_us = now;
+    }
+    return now - start_us;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    pthread_mutex_lock(&s_clock_lock);
+    int64_t now = s_clock_virtual ? s_clock_us : monotonic_us();
+    pthread_mutex_unlock(&s_clock_lock);
+    return now;
+}
+
+void host_clock_set_virtual(bool enable)
+{
+    pthread_mutex_lock(&s_clock_lock);
+    if (enable && !s_clock_virtual) {
+        s_clock_us = monotonic_us();
+    }
+    s_clock_virtual = enable;
+    pthread_mutex_unlock(&s_clock_lock);
+}
+
+bool host_clock_is_virtual(void)
+{
+    pthread_mutex_lock(&s_clock_lock);
+    bool virt = s_clock_virtual;
+    pthread_mutex_unlock(&s_clock_lock);
+    return virt;
+}
+
+void host_clock_advance(int64_t us)
+{
+    pthread_mutex_lock(&s_clock_lock);
+    s_clock_us += us;
+    pthread_mutex_unlock(&s_clock_lock);
+}
+
+void host_clock_set(int64_t us)
+{
+    pthread_mutex_lock(&s_clock_lock);
+    s_clock_us = us;
+    pthread_mutex_unlock(&s_clock_lock);
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320U & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t s_gpio_level[HOST_GPIO_NUM];
+static uint32_t s_gpio_writes[HOST_GPIO_NUM];
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    return config && config->pin_bit_mask ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (gpio_num < 0 || gpio_num >= HOST_GPIO_NUM) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_gpio_level[gpio_num] = level;
+    s_gpio_writes[gpio_num]++;
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    return gpio_num >= 0 && gpio_num < HOST_GPIO_NUM ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+uint32_t host_gpio_get_level(gpio_num_t gpio_num)
+{
+    return s_gpio_level[gpio_num];
+}
+
+uint32_t host_gpio_get_writes(gpio_num_t gpio_num)
+{
+    return s_gpio_writes[gpio_num];
+}
+
+int spi_get_actual_clock(int fapb, int hz, int duty_cycle)
+{
+    (void)duty_cycle;
+    if (hz <= 0) {
+        return 0;
+    }
+    // nearest integer divider, may land above hz like the target's
+    int n = (fapb + hz / 2) / hz;
+    return fapb / (n < 1 ? 1 : n);
+}
+
+static struct {
+    char ns[16];
+    char key[16];
+    uint32_t value;
+} s_nvs[HOST_NVS_MAX];
+static int s_nvs_num;
+static char s_nvs_open[16];
+static esp_err_t s_nvs_fail;
+
+void host_nvs_reset(void)
+{
+    s_nvs_num = 0;
+    s_nvs_fail = ESP_OK;
+}
+
+void host_nvs_fail_next(esp_err_t err)
+{
+    s_nvs_fail = err;
+}
+
+static esp_err_t nvs_injected(void)
+{
+    esp_err_t err = s_nvs_fail;
+    s_nvs_fail = ESP_OK;
+    return err;
+}
+
+static int nvs_find(const char *ns, const char *key)
+{
+    for (int i = 0; i < s_nvs_num; i++) {
+        if (!strcmp(s_nvs[i].ns, ns) && (!key || !strcmp(s_nvs[i].key, key))) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    esp_err_t err = nvs_injected();
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (strlen(namespace_name) >= sizeof(s_nvs_open)) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+    // like NVS, a read-only open of a namespace that was never written fails
+    if (open_mode == NVS_READONLY && nvs_find(namespace_name, NULL) < 0) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    strcpy(s_nvs_open, namespace_name);
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    esp_err_t err = nvs_injected();
+    if (err != ESP_OK) {
+        return err;
+    }
+    int i = nvs_find(s_nvs_open, key);
+    if (i < 0) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out_value = s_nvs[i].value;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    esp_err_t err = nvs_injected();
+    if (err != ESP_OK) {
+        return err;
+    }
+    int i = nvs_find(s_nvs_open, key);
+    if (i < 0) {
+        if (s_nvs_num == HOST_NVS_MAX || strlen(key) >= sizeof(s_nvs[0].key)) {
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        }
+        i = s_nvs_num++;
+        strcpy(s_nvs[i].ns, s_nvs_open);
+        strcpy(s_nvs[i].key, key);
+    }
+    s_nvs[i].value = value;
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return nvs_injected();
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
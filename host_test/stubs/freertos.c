@@ -0,0 +1,241 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+struct host_queue_t {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    uint8_t *items;
+    size_t item_size;
+    size_t length;
+    size_t count;
+    size_t head;
+};
+
+struct host_task_t {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+};
+
+static __thread struct host_task_t *s_self;
+static pthread_mutex_t s_critical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+void host_critical_enter(portMUX_TYPE *mux)
+{
+    (void)mux;
+    pthread_mutex_lock(&s_critical);
+}
+
+void host_critical_exit(portMUX_TYPE *mux)
+{
+    (void)mux;
+    pthread_mutex_unlock(&s_critical);
+}
+
+static void deadline_after(TickType_t ticks, struct timespec *ts)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    uint64_t ns = ts->tv_nsec + (uint64_t)ticks * 1000000ULL * portTICK_PERIOD_MS;
+    ts->tv_sec += ns / 1000000000ULL;
+    ts->tv_nsec = ns % 1000000000ULL;
+}
+
+// waits use the real clock even when esp_timer runs virtual, a timeout here means the test hung
+static bool wait_changed(struct host_queue_t *q, TickType_t ticks, const struct timespec *deadline)
+{
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(&q->changed, &q->lock);
+        return true;
+    }
+    return pthread_cond_timedwait(&q->changed, &q->lock, deadline) != ETIMEDOUT;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue_t *q = calloc(1, sizeof(struct host_queue_t));
+    if (!q) {
+        return NULL;
+    }
+    q->items = calloc(length, item_size ? item_size : 1);
+    if (!q->items) {
+        free(q);
+        return NULL;
+    }
+    q->item_size = item_size;
+    q->length = length;
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&q->changed, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&q->lock, NULL);
+    return q;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    struct host_queue_t *q = xQueueCreate(max_count, 0);
+    if (q) {
+        q->count = initial_count;
+    }
+    return q;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    pthread_cond_destroy(&q->changed);
+    pthread_mutex_destroy(&q->lock);
+    free(q->items);
+    free(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    deadline_after(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->length) {
+        if (!ticks_to_wait || !wait_changed(q, ticks_to_wait, &deadline)) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFALSE;
+        }
+    }
+    if (q->item_size) {
+        memcpy(&q->items[((q->head + q->count) % q->length) * q->item_size], item, q->item_size);
+    }
+    q->count++;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *item, BaseType_t *higher_prio_task_woken)
+{
+    if (higher_prio_task_woken) {
+        *higher_prio_task_woken = pdFALSE;
+    }
+    return xQueueSend(q, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *buf, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    deadline_after(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&q->lock);
+    while (!q->count) {
+        if (!ticks_to_wait || !wait_changed(q, ticks_to_wait, &deadline)) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFALSE;
+        }
+    }
+    if (q->item_size) {
+        memcpy(buf, &q->items[q->head * q->item_size], q->item_size);
+        q->head = (q->head + 1) % q->length;
+    }
+    q->count--;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t count = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return count;
+}
+
+static void *task_entry(void *arg)
+{
+    s_self = arg;
+    s_self->fn(s_self->arg);
+    // returning from a task function is an error on FreeRTOS, tolerate it here
+    free(s_self);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *ret_task, BaseType_t core_id)
+{
+    (void)name;
+    (void)stack_depth;
+    (void)priority;
+    (void)core_id;
+    struct host_task_t *task = calloc(1, sizeof(struct host_task_t));
+    if (!task) {
+        return pdFAIL;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    if (pthread_create(&task->thread, NULL, task_entry, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    if (ret_task) {
+        *ret_task = task;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task) {
+        fprintf(stderr, "vTaskDelete() of another task is not supported on the host\n");
+        abort();
+    }
+    // like on target the handle the creator got is dangling from here on
+    free(s_self);
+    s_self = NULL;
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    int64_t us = (int64_t)ticks * 1000 * portTICK_PERIOD_MS;
+    if (host_clock_is_virtual()) {
+        host_clock_advance(us);
+        return;
+    }
+    struct timespec ts = {
+        .tv_sec = us / 1000000,
+        .tv_nsec = (us % 1000000) * 1000,
+    };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / 1000 / portTICK_PERIOD_MS);
+}
+
+BaseType_t xTaskDelayUntil(TickType_t *prev_wake_time, TickType_t increment)
+{
+    TickType_t wake = *prev_wake_time + increment;
+    TickType_t now = xTaskGetTickCount();
+    *prev_wake_time = wake;
+    if ((int32_t)(wake - now) <= 0) {
+        return pdFALSE;
+    }
+    vTaskDelay(wake - now);
+    return pdTRUE;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    SPI1_HOST,
+    SPI2_HOST,
+    SPI3_HOST,
+} spi_host_device_t;
+
+// the clock an SPI master divides down to for hz, src_clk / n like the target's clock dividers
+int spi_get_actual_clock(int fapb, int hz, int duty_cycle);
+
+#ifdef __cplusplus
+}
+#endif
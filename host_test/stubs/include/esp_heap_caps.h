@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MALLOC_CAP_DMA              (1 << 3)
+#define MALLOC_CAP_8BIT             (1 << 2)
+#define MALLOC_CAP_INTERNAL         (1 << 11)
+#define MALLOC_CAP_SPIRAM           (1 << 10)
+#define MALLOC_CAP_DEFAULT          (1 << 12)
+
+// plain malloc/free on the host, the driver frees some of these buffers with free() just like on target
+static inline void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    return malloc(size);
+}
+
+static inline void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    (void)caps;
+    return calloc(n, size);
+}
+
+static inline void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Microseconds since the test started. With host_clock_set_virtual(true) the clock only moves through
+ * vTaskDelay()/xTaskDelayUntil() and host_clock_advance(), which makes timing-dependent code deterministic.
+ */
+int64_t esp_timer_get_time(void);
+
+void host_clock_set_virtual(bool enable);
+
+bool host_clock_is_virtual(void);
+
+void host_clock_advance(int64_t us);
+
+void host_clock_set(int64_t us);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+
+// FreeRTOS on pthreads: tasks are threads, one tick is one millisecond of esp_timer_get_time()
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_bit_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE                     ((BaseType_t)0)
+#define pdTRUE                      ((BaseType_t)1)
+#define pdFAIL                      pdFALSE
+#define pdPASS                      pdTRUE
+
+#define configTICK_RATE_HZ          (1000)
+#define portTICK_PERIOD_MS          ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY               ((TickType_t)0xFFFFFFFFUL)
+#define pdMS_TO_TICKS(ms)           ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000U))
+#define tskNO_AFFINITY              (0x7FFFFFFF)
+
+// all critical sections share one recursive lock, callbacks from the mock "DMA" thread stand in for ISRs
+typedef struct {
+    int owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portMUX_INITIALIZE(mux)     ((mux)->owner = 0)
+
+void host_critical_enter(portMUX_TYPE *mux);
+
+void host_critical_exit(portMUX_TYPE *mux);
+
+#define portENTER_CRITICAL(mux)     host_critical_enter(mux)
+#define portEXIT_CRITICAL(mux)      host_critical_exit(mux)
+#define portENTER_CRITICAL_ISR(mux) host_critical_enter(mux)
+#define portEXIT_CRITICAL_ISR(mux)  host_critical_exit(mux)
+#define portYIELD_FROM_ISR(...)     ((void)0)
+
+#ifdef __cplusplus
+}
+#endif
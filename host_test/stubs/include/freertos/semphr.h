@@ -0,0 +1,30 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// semaphores are queues of empty items, as in FreeRTOS
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count);
+
+static inline SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+
+#define xSemaphoreTake(sem, ticks)                      xQueueReceive((sem), NULL, (ticks))
+#define xSemaphoreGive(sem)                             xQueueSend((sem), NULL, 0)
+#define xSemaphoreGiveFromISR(sem, woken)               xQueueSendFromISR((sem), NULL, (woken))
+#define uxSemaphoreGetCount(sem)                        uxQueueMessagesWaiting(sem)
+#define vSemaphoreDelete(sem)                           vQueueDelete(sem)
+
+#ifdef __cplusplus
+}
+#endif
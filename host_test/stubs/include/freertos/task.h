@@ -0,0 +1,32 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*TaskFunction_t)(void *arg);
+typedef struct host_task_t *TaskHandle_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *ret_task, BaseType_t core_id);
+
+static inline BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                     UBaseType_t priority, TaskHandle_t *ret_task)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack_depth, arg, priority, ret_task, tskNO_AFFINITY);
+}
+
+// only vTaskDelete(NULL) is supported, a task ends itself
+void vTaskDelete(TaskHandle_t task);
+
+void vTaskDelay(TickType_t ticks);
+
+BaseType_t xTaskDelayUntil(TickType_t *prev_wake_time, TickType_t increment);
+
+TickType_t xTaskGetTickCount(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,9 @@
+#pragma once
+
+// newlib's sys/cdefs.h provides __containerof, glibc's doesn't
+#include_next <sys/cdefs.h>
+#include <stddef.h>
+
+#ifndef __containerof
+#define __containerof(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+#endif
@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 
+#include "esp_lcd_panel_io.h"
 #include "esp_lcd_panel_vendor.h"
 
 #ifdef __cplusplus
@@ -25,6 +26,157 @@ typedef struct {
 
 esp_err_t esp_lcd_new_panel_st77912(const esp_lcd_panel_io_handle_t io, const esp_lcd_panel_dev_config_t *panel_dev_config, esp_lcd_panel_handle_t *ret_panel);
 
+typedef struct {
+    uint32_t start_pclk_hz;     // known-good clock, all readbacks are taken here
+    uint32_t max_pclk_hz;       // highest clock probed
+    uint32_t src_clk_hz;        // SPI source clock, the bus runs at src_clk_hz / n
+    uint8_t rounds;             // readback probes per clock step, every one must match the reference
+    uint8_t margin_percent;     // backed off from the highest stable clock
+    const char *nvs_namespace;  // store the result here, NULL to skip persisting
+} st77912_pclk_calib_config_t;
+
+/**
+ * Step pclk_hz up from start_pclk_hz through the clocks the bus can actually run at (src_clk_hz / n), writing
+ * test patterns into GRAM at each one and reading them back (RAMRD) at start_pclk_hz, since pclk_hz only drives
+ * writes. The CRC of each readback must match the reference taken at start_pclk_hz. The highest clock that passes,
+ * backed off by margin_percent to the next achievable clock below, is returned and optionally written to NVS
+ * (nvs_flash_init() must have run). *ret_pclk_hz is set even if storing it fails.
+ *
+ * The bus must be able to read from the panel (MISO wired, or sio_mode for 3-wire), otherwise
+ * ESP_ERR_NOT_SUPPORTED is returned. Panel IO and panel handles are created and deleted internally,
+ * io_config->pclk_hz and its callbacks are ignored.
+ */
+esp_err_t esp_lcd_st77912_calibrate_pclk(esp_lcd_spi_bus_handle_t bus, const esp_lcd_panel_io_spi_config_t *io_config, const esp_lcd_panel_dev_config_t *panel_dev_config,
+                                         const st77912_pclk_calib_config_t *calib_config, uint32_t *ret_pclk_hz);
+
+/**
+ * Read a clock stored by esp_lcd_st77912_calibrate_pclk(), ESP_ERR_NOT_FOUND if calibration never ran.
+ * Other NVS errors (e.g. nvs_flash_init() not called) are returned as they are.
+ */
+esp_err_t esp_lcd_st77912_load_pclk(const char *nvs_namespace, uint32_t *ret_pclk_hz);
+
+#define ST77912_PCLK_CALIB_DEFAULT_CONFIG()                     \
+    {                                                           \
+        .start_pclk_hz = 10 * 1000 * 1000,                      \
+        .max_pclk_hz = 80 * 1000 * 1000,                        \
+        .src_clk_hz = 80 * 1000 * 1000,                         \
+        .rounds = 4,                                            \
+        .margin_percent = 15,                                   \
+        .nvs_namespace = "st77912",                             \
+    }
+
+typedef struct {
+    uint32_t tx_errors;         // failed bus transfers, including ones that went through on retry
+    uint32_t rx_errors;         // failed reads, RDDST polls and calibration readbacks
+    uint32_t tx_retries;        // draw_bitmap windows sent again after a failed transfer
+    uint32_t tx_failures;       // draw_bitmap windows still failing after all retries
+    uint32_t panel_resets;      // self-resets detected by esp_lcd_st77912_check_health()
+    uint32_t recoveries;        // fast re-inits that completed
+} st77912_fault_stats_t;
+
+/**
+ * Called after a recovery with the area (panel coordinates, end exclusive) whose GRAM content was lost,
+ * the application should redraw it with esp_lcd_panel_draw_bitmap().
+ */
+typedef void (*st77912_recover_cb_t)(esp_lcd_panel_handle_t panel, int x_start, int y_start, int x_end, int y_end, void *user_ctx);
+
+typedef struct {
+    uint8_t max_tx_retries;     // extra attempts for a failed draw_bitmap window, 2 by default
+    st77912_recover_cb_t on_recover;
+    void *user_ctx;
+} st77912_recovery_config_t;
+
+esp_err_t esp_lcd_st77912_set_recovery(esp_lcd_panel_handle_t panel, const st77912_recovery_config_t *config);
+
+/**
+ * Poll the display status (RDDST). If the panel has reset itself (sleep-in, MADCTL or display-on lost),
+ * replay the init sequence without SWRESET, restore MADCTL/inversion/display-on, then hand every area
+ * drawn since init to on_recover. Areas whose transfer failed after all retries are handed over as well.
+ * Call it periodically from the task that owns the panel.
+ */
+esp_err_t esp_lcd_st77912_check_health(esp_lcd_panel_handle_t panel);
+
+esp_err_t esp_lcd_st77912_get_fault_stats(esp_lcd_panel_handle_t panel, st77912_fault_stats_t *ret_stats);
+
+typedef enum {
+    ST77912_TRACE_PARAM = 1,    // command with parameters, cmd + len + up to 8 parameter bytes
+    ST77912_TRACE_COLOR,        // pixel data, cmd + byte count (uint32 LE in data)
+    ST77912_TRACE_READ,         // read command, cmd + len
+    ST77912_TRACE_DRAW,         // draw_bitmap call, x_start/y_start/x_end/y_end (int16 LE in data) before gaps
+    ST77912_TRACE_RESET,        // panel reset, cmd is 1 for hardware and 0 for SWRESET
+    ST77912_TRACE_INIT,         // init sequence starts, cmd is 1 for the fast re-init after a recovery
+    ST77912_TRACE_GAP,          // set_gap, x/y gap (int16 LE in data)
+    ST77912_TRACE_CALL,         // API call that sends commands of its own, cmd is st77912_trace_call_t
+} st77912_trace_type_t;
+
+typedef enum {
+    ST77912_TRACE_CALL_MIRROR = 1,      // mirror_x/mirror_y in data[0..1]
+    ST77912_TRACE_CALL_SWAP_XY,         // swap_axes in data[0]
+    ST77912_TRACE_CALL_INVERT,          // invert_color_data in data[0]
+    ST77912_TRACE_CALL_DISP_ON_OFF,     // on_off in data[0]
+    ST77912_TRACE_CALL_SEND_CMDS,       // len commands, each followed by its PARAM record
+    ST77912_TRACE_CALL_CHECK_HEALTH,
+} st77912_trace_call_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t timestamp_us;      // low 32 bits of esp_timer_get_time()
+    uint8_t type;               // st77912_trace_type_t
+    uint8_t cmd;
+    uint16_t len;
+    uint8_t data[8];
+} st77912_trace_rec_t;
+
+/**
+ * Record every panel operation into buf, used as a ring of st77912_trace_rec_t (16 bytes each) that keeps the
+ * newest records. buf must stay valid while the trace is read out, after esp_lcd_st77912_trace_stop() too.
+ * tools/st77912_trace.py analyzes dumps, and replays the recorded calls through another driver build on the host.
+ */
+esp_err_t esp_lcd_st77912_trace_start(esp_lcd_panel_handle_t panel, void *buf, size_t size);
+
+esp_err_t esp_lcd_st77912_trace_stop(esp_lcd_panel_handle_t panel);
+
+/**
+ * Copy up to max_recs records, oldest first. *ret_dropped (optional) is the number overwritten since start.
+ */
+esp_err_t esp_lcd_st77912_trace_get(esp_lcd_panel_handle_t panel, st77912_trace_rec_t *recs, size_t max_recs, size_t *ret_num, uint32_t *ret_dropped);
+
+/**
+ * Print the trace to the console as text lines that tools/st77912_trace.py picks out of a serial log.
+ */
+esp_err_t esp_lcd_st77912_trace_dump(esp_lcd_panel_handle_t panel);
+
+typedef struct {
+    // after every successful draw_bitmap, bytes is the pixel data that went out on the bus
+    void (*on_draw)(esp_lcd_panel_handle_t panel, int x_start, int y_start, int x_end, int y_end, size_t bytes, void *user_ctx);
+    // after the init sequence ran again (panel init or recovery), registers are back to the init table values
+    void (*on_init)(esp_lcd_panel_handle_t panel, void *user_ctx);
+    void *user_ctx;
+} st77912_panel_hooks_t;
+
+/**
+ * Observe panel traffic, called from the task doing the draw. Pass NULL to remove the hooks.
+ * A panel has one set of hooks: installing them while others are in place fails with ESP_ERR_INVALID_STATE,
+ * remove those first.
+ */
+esp_err_t esp_lcd_st77912_set_hooks(esp_lcd_panel_handle_t panel, const st77912_panel_hooks_t *hooks);
+
+/**
+ * Report pixels sent straight through the panel IO, bypassing draw_bitmap (e.g. the C++ Panel::draw()): the area
+ * is redrawn after a recovery and passed to the on_draw hook, as if draw_bitmap had sent it. It is not traced.
+ */
+esp_err_t esp_lcd_st77912_notify_draw(esp_lcd_panel_handle_t panel, int x_start, int y_start, int x_end, int y_end);
+
+/**
+ * The hooks in place, all NULL if there are none.
+ */
+esp_err_t esp_lcd_st77912_get_hooks(esp_lcd_panel_handle_t panel, st77912_panel_hooks_t *ret_hooks);
+
+/**
+ * Send a list of register writes in the init table format, e.g. to change vendor registers at runtime.
+ * The list must leave the command bank (F0h/F1h) selected the way it found it.
+ */
+esp_err_t esp_lcd_st77912_send_cmds(esp_lcd_panel_handle_t panel, const st77912_lcd_init_cmd_t *cmds, uint16_t cmds_size);
+
 #define ST77912_PANEL_BUS_SPI_CONFIG(sclk, mosi, max_trans_sz)  \
     {                                                           \
         .sclk_io_num = sclk,                                    \
@@ -0,0 +1,529 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_lcd_panel_io.h"
+#include "esp_lcd_panel_ops.h"
+
+#include "esp_lcd_st77912.h"
+
+/**
+ * Header-only C++ front end for the ST77912 driver. Geometry, pixel format, gaps and SPI/QSPI are template
+ * parameters, so command encodings, window bytes and buffer sizes are constants and Panel::draw() goes straight
+ * to the panel IO without the esp_lcd_panel_t function table or the driver's runtime interface checks.
+ *
+ * The C driver still creates, resets and initializes the panel; everything it offers stays available through
+ * Panel::handle(). Panel::draw() reports each window to the driver, so on_draw hooks and the redraw area after a
+ * recovery see it, but skips the retries and tracing of the C draw path; use Panel::draw_checked() where those matter.
+ *
+ * No exceptions are thrown, failures are reported as esp_err_t like in the C API.
+ */
+namespace esp_lcd_st77912 {
+
+enum class Bus {
+    Spi,
+    Qspi,
+};
+
+enum class PixelFormat {
+    Rgb565,
+    Rgb666,     // one byte per color component, 6 high bits used
+};
+
+struct Rgb666 {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+};
+
+template <PixelFormat Fmt> struct PixelTraits;
+
+template <> struct PixelTraits<PixelFormat::Rgb565> {
+    using pixel_t = uint16_t;
+    static constexpr unsigned bits_per_pixel = 16;      // esp_lcd_panel_dev_config_t::bits_per_pixel
+};
+
+template <> struct PixelTraits<PixelFormat::Rgb666> {
+    using pixel_t = Rgb666;
+    static constexpr unsigned bits_per_pixel = 18;
+};
+
+template <Bus B> struct BusTraits;
+
+template <> struct BusTraits<Bus::Spi> {
+    static constexpr int param_cmd(uint8_t cmd)
+    {
+        return cmd;
+    }
+    static constexpr int color_cmd(uint8_t cmd)
+    {
+        return cmd;
+    }
+};
+
+template <> struct BusTraits<Bus::Qspi> {
+    // opcode in the top byte, the command in bits 15..8 of the 32-bit command phase
+    static constexpr int param_cmd(uint8_t cmd)
+    {
+        return static_cast<int>((0x02UL << 24) | (static_cast<uint32_t>(cmd) << 8));
+    }
+    static constexpr int color_cmd(uint8_t cmd)
+    {
+        return static_cast<int>((0x32UL << 24) | (static_cast<uint32_t>(cmd) << 8));
+    }
+};
+
+/**
+ * Heap buffer owned by one object, freed with heap_caps_free(). Move-only.
+ */
+template <typename T>
+class DmaBuffer {
+public:
+    DmaBuffer() = default;
+
+    static DmaBuffer allocate(size_t count, uint32_t caps = MALLOC_CAP_DMA)
+    {
+        DmaBuffer buf;
+        buf.data_ = static_cast<T *>(heap_caps_malloc(count * sizeof(T), caps));
+        buf.count_ = buf.data_ ? count : 0;
+        return buf;
+    }
+
+    DmaBuffer(const DmaBuffer &) = delete;
+    DmaBuffer &operator=(const DmaBuffer &) = delete;
+
+    DmaBuffer(DmaBuffer &&other) noexcept : data_(std::exchange(other.data_, nullptr)), count_(std::exchange(other.count_, 0)) {}
+
+    DmaBuffer &operator=(DmaBuffer &&other) noexcept
+    {
+        if (this != &other) {
+            heap_caps_free(data_);
+            data_ = std::exchange(other.data_, nullptr);
+            count_ = std::exchange(other.count_, 0);
+        }
+        return *this;
+    }
+
+    ~DmaBuffer()
+    {
+        heap_caps_free(data_);
+    }
+
+    explicit operator bool() const
+    {
+        return data_ != nullptr;
+    }
+    T *data() const
+    {
+        return data_;
+    }
+    size_t size() const
+    {
+        return count_;
+    }
+    T &operator[](size_t i) const
+    {
+        return data_[i];
+    }
+
+private:
+    T *data_ = nullptr;
+    size_t count_ = 0;
+};
+
+/**
+ * What Panel::create() passes on to the C driver, besides what the template fixes.
+ */
+struct PanelConfig {
+    int reset_gpio_num = -1;
+    bool reset_active_high = false;
+    lcd_rgb_element_order_t rgb_ele_order = LCD_RGB_ELEMENT_ORDER_RGB;
+    const st77912_vendor_config_t *vendor_config = nullptr;    // may override the init table
+    bool disp_on = true;
+};
+
+template <int HRes, int VRes, PixelFormat Fmt = PixelFormat::Rgb565, Bus B = Bus::Spi, int XGap = 0, int YGap = 0>
+class Panel {
+    static_assert(HRes > 0 && VRes > 0, "resolution must be positive");
+    static_assert(XGap >= 0 && YGap >= 0 && HRes + XGap <= 0x10000 && VRes + YGap <= 0x10000, "window exceeds the 16-bit address range");
+
+public:
+    using pixel_t = typename PixelTraits<Fmt>::pixel_t;
+
+    static constexpr int h_res = HRes;
+    static constexpr int v_res = VRes;
+    static constexpr size_t bytes_per_pixel = sizeof(pixel_t);
+    static constexpr size_t line_bytes = HRes * bytes_per_pixel;
+    static constexpr size_t frame_bytes = line_bytes * VRes;
+
+    static constexpr int caset_cmd = BusTraits<B>::param_cmd(0x2A);
+    static constexpr int raset_cmd = BusTraits<B>::param_cmd(0x2B);
+    static constexpr int ramwr_cmd = BusTraits<B>::color_cmd(0x2C);
+
+    static constexpr size_t band_bytes(int lines)
+    {
+        return line_bytes * lines;
+    }
+
+    // CASET/RASET parameters for [start, end), gap applied
+    static constexpr std::array<uint8_t, 4> window_bytes(int start, int end, int gap)
+    {
+        return {
+            static_cast<uint8_t>(((start + gap) >> 8) & 0xFF),
+            static_cast<uint8_t>((start + gap) & 0xFF),
+            static_cast<uint8_t>(((end - 1 + gap) >> 8) & 0xFF),
+            static_cast<uint8_t>((end - 1 + gap) & 0xFF),
+        };
+    }
+
+    Panel() = default;
+
+    /**
+     * Create, reset and initialize the panel with the C driver, set the gaps, and optionally turn it on.
+     * The vendor config's use_qspi_interface flag is set from the template.
+     */
+    static esp_err_t create(esp_lcd_panel_io_handle_t io, const PanelConfig &config, Panel *ret_panel)
+    {
+        ESP_RETURN_ON_FALSE(io && ret_panel, ESP_ERR_INVALID_ARG, "st77912_cpp", "invalid argument");
+
+        st77912_vendor_config_t vendor = {};
+        if (config.vendor_config) {
+            vendor = *config.vendor_config;
+        }
+        vendor.flags.use_qspi_interface = (B == Bus::Qspi);
+        esp_lcd_panel_dev_config_t dev_config = {};
+        dev_config.reset_gpio_num = config.reset_gpio_num;
+        dev_config.rgb_ele_order = config.rgb_ele_order;
+        dev_config.bits_per_pixel = PixelTraits<Fmt>::bits_per_pixel;
+        dev_config.flags.reset_active_high = config.reset_active_high;
+        dev_config.vendor_config = &vendor;
+
+        Panel panel;
+        panel.io_ = io;
+        ESP_RETURN_ON_ERROR(esp_lcd_new_panel_st77912(io, &dev_config, &panel.handle_), "st77912_cpp", "create panel failed");
+        ESP_RETURN_ON_ERROR(esp_lcd_panel_reset(panel.handle_), "st77912_cpp", "reset failed");
+        ESP_RETURN_ON_ERROR(esp_lcd_panel_init(panel.handle_), "st77912_cpp", "init failed");
+        ESP_RETURN_ON_ERROR(esp_lcd_panel_set_gap(panel.handle_, XGap, YGap), "st77912_cpp", "set gap failed");
+        if (config.disp_on) {
+            ESP_RETURN_ON_ERROR(esp_lcd_panel_disp_on_off(panel.handle_, true), "st77912_cpp", "display on failed");
+        }
+        *ret_panel = std::move(panel);
+        return ESP_OK;
+    }
+
+    /**
+     * RGB order and a reset line driven low, see PanelConfig for the rest.
+     */
+    static esp_err_t create(esp_lcd_panel_io_handle_t io, int reset_gpio_num, Panel *ret_panel,
+                            const st77912_vendor_config_t *vendor_config = nullptr, bool disp_on = true)
+    {
+        PanelConfig config;
+        config.reset_gpio_num = reset_gpio_num;
+        config.vendor_config = vendor_config;
+        config.disp_on = disp_on;
+        return create(io, config, ret_panel);
+    }
+
+    Panel(const Panel &) = delete;
+    Panel &operator=(const Panel &) = delete;
+
+    Panel(Panel &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)), io_(std::exchange(other.io_, nullptr)) {}
+
+    Panel &operator=(Panel &&other) noexcept
+    {
+        if (this != &other) {
+            reset_handle();
+            handle_ = std::exchange(other.handle_, nullptr);
+            io_ = std::exchange(other.io_, nullptr);
+        }
+        return *this;
+    }
+
+    ~Panel()
+    {
+        reset_handle();
+    }
+
+    esp_lcd_panel_handle_t handle() const
+    {
+        return handle_;
+    }
+    esp_lcd_panel_io_handle_t io() const
+    {
+        return io_;
+    }
+
+    /**
+     * Send [x_start, x_end) x [y_start, y_end). Returns once the pixel transfer is queued, colors must stay
+     * untouched until the IO reports it done (see FramePool).
+     */
+    inline __attribute__((always_inline)) esp_err_t draw(int x_start, int y_start, int x_end, int y_end, const pixel_t *colors) const
+    {
+        const std::array<uint8_t, 4> caset = window_bytes(x_start, x_end, XGap);
+        const std::array<uint8_t, 4> raset = window_bytes(y_start, y_end, YGap);
+        esp_err_t ret = esp_lcd_panel_io_tx_param(io_, caset_cmd, caset.data(), caset.size());
+        if (ret == ESP_OK) {
+            ret = esp_lcd_panel_io_tx_param(io_, raset_cmd, raset.data(), raset.size());
+        }
+        if (ret == ESP_OK) {
+            ret = esp_lcd_panel_io_tx_color(io_, ramwr_cmd, colors, static_cast<size_t>(x_end - x_start) * (y_end - y_start) * bytes_per_pixel);
+        }
+        if (ret == ESP_OK) {
+            ret = esp_lcd_st77912_notify_draw(handle_, x_start, y_start, x_end, y_end);
+        }
+        return ret;
+    }
+
+    /**
+     * Same as draw() for a window known at compile time, e.g. a status bar, whose bounds are checked when building.
+     */
+    template <int XStart, int YStart, int XEnd, int YEnd>
+    inline __attribute__((always_inline)) esp_err_t draw(const pixel_t *colors) const
+    {
+        static_assert(0 <= XStart && XStart < XEnd && XEnd <= HRes, "window outside the panel");
+        static_assert(0 <= YStart && YStart < YEnd && YEnd <= VRes, "window outside the panel");
+        static constexpr std::array<uint8_t, 4> caset = window_bytes(XStart, XEnd, XGap);
+        static constexpr std::array<uint8_t, 4> raset = window_bytes(YStart, YEnd, YGap);
+        static constexpr size_t len = static_cast<size_t>(XEnd - XStart) * (YEnd - YStart) * bytes_per_pixel;
+        esp_err_t ret = esp_lcd_panel_io_tx_param(io_, caset_cmd, caset.data(), caset.size());
+        if (ret == ESP_OK) {
+            ret = esp_lcd_panel_io_tx_param(io_, raset_cmd, raset.data(), raset.size());
+        }
+        if (ret == ESP_OK) {
+            ret = esp_lcd_panel_io_tx_color(io_, ramwr_cmd, colors, len);
+        }
+        if (ret == ESP_OK) {
+            ret = esp_lcd_st77912_notify_draw(handle_, XStart, YStart, XEnd, YEnd);
+        }
+        return ret;
+    }
+
+    /**
+     * Through esp_lcd_panel_draw_bitmap(), with the C driver's retries, tracing, hooks and recovery bookkeeping.
+     */
+    esp_err_t draw_checked(int x_start, int y_start, int x_end, int y_end, const pixel_t *colors) const
+    {
+        return esp_lcd_panel_draw_bitmap(handle_, x_start, y_start, x_end, y_end, colors);
+    }
+
+    static DmaBuffer<pixel_t> alloc_band(int lines, uint32_t caps = MALLOC_CAP_DMA)
+    {
+        return DmaBuffer<pixel_t>::allocate(static_cast<size_t>(HRes) * lines, caps);
+    }
+
+private:
+    void reset_handle()
+    {
+        if (handle_) {
+            esp_lcd_panel_del(handle_);
+            handle_ = nullptr;
+        }
+    }
+
+    esp_lcd_panel_handle_t handle_ = nullptr;
+    esp_lcd_panel_io_handle_t io_ = nullptr;
+};
+
+/**
+ * NumBufs DMA band buffers of Lines lines each, recycled when the panel IO reports the transfer done.
+ * Registers its own on_color_trans_done callback on the panel IO, so it can't be shared with anything else that
+ * does, like the compositor or the MJPEG player. Direct draws on the same IO may go out between submits: completions
+ * arrive in order and only as many as there are bands in flight free a buffer, but a draw still on the bus when
+ * the next band is submitted would be taken for that band. One frame may be checked out at a time, from a single task.
+ */
+template <typename PanelT, int Lines, int NumBufs = 2>
+class FramePool {
+    static_assert(Lines > 0 && Lines <= PanelT::v_res, "band height out of range");
+    static_assert(NumBufs >= 2, "at least two buffers are needed to overlap drawing and sending");
+
+public:
+    using pixel_t = typename PanelT::pixel_t;
+    static constexpr size_t band_pixels = static_cast<size_t>(PanelT::h_res) * Lines;
+
+    /**
+     * A checked-out band buffer. Hand it back with FramePool::submit(), or let it go out of scope to return it unsent.
+     */
+    class Frame {
+    public:
+        Frame() = default;
+        Frame(const Frame &) = delete;
+        Frame &operator=(const Frame &) = delete;
+
+        Frame(Frame &&other) noexcept : pool_(std::exchange(other.pool_, nullptr)), pixels_(std::exchange(other.pixels_, nullptr)) {}
+
+        Frame &operator=(Frame &&other) noexcept
+        {
+            if (this != &other) {
+                release();
+                pool_ = std::exchange(other.pool_, nullptr);
+                pixels_ = std::exchange(other.pixels_, nullptr);
+            }
+            return *this;
+        }
+
+        ~Frame()
+        {
+            release();
+        }
+
+        explicit operator bool() const
+        {
+            return pixels_ != nullptr;
+        }
+        pixel_t *pixels() const
+        {
+            return pixels_;
+        }
+        static constexpr int lines()
+        {
+            return Lines;
+        }
+
+    private:
+        friend class FramePool;
+        Frame(FramePool *pool, pixel_t *pixels) : pool_(pool), pixels_(pixels) {}
+
+        void release()
+        {
+            if (pool_) {
+                pool_->unacquire();
+                pool_ = nullptr;
+                pixels_ = nullptr;
+            }
+        }
+
+        FramePool *pool_ = nullptr;
+        pixel_t *pixels_ = nullptr;
+    };
+
+    FramePool() = default;
+    FramePool(const FramePool &) = delete;
+    FramePool &operator=(const FramePool &) = delete;
+
+    ~FramePool()
+    {
+        if (free_bufs_) {
+            // wait for the transfers still reading the buffers, the callback must not fire after this
+            for (int i = 0; i < NumBufs; i++) {
+                xSemaphoreTake(free_bufs_, portMAX_DELAY);
+            }
+            if (panel_) {
+                const esp_lcd_panel_io_callbacks_t cbs = {};
+                esp_lcd_panel_io_register_event_callbacks(panel_->io(), &cbs, nullptr);
+            }
+            vSemaphoreDelete(free_bufs_);
+        }
+    }
+
+    /**
+     * The pool keeps a pointer to panel, which must outlive it and must not be moved meanwhile.
+     */
+    esp_err_t init(const PanelT &panel, uint32_t caps = MALLOC_CAP_DMA)
+    {
+        ESP_RETURN_ON_FALSE(panel.handle() && !free_bufs_, ESP_ERR_INVALID_STATE, "st77912_cpp", "invalid state");
+        for (int i = 0; i < NumBufs; i++) {
+            bufs_[i] = DmaBuffer<pixel_t>::allocate(band_pixels, caps);
+            ESP_RETURN_ON_FALSE(bufs_[i], ESP_ERR_NO_MEM, "st77912_cpp", "no mem for band buffer");
+        }
+        free_bufs_ = xSemaphoreCreateCounting(NumBufs, NumBufs);
+        ESP_RETURN_ON_FALSE(free_bufs_, ESP_ERR_NO_MEM, "st77912_cpp", "no mem for buffer semaphore");
+        // the destructor unregisters through panel_, set it before there is anything to unregister
+        panel_ = &panel;
+        const esp_lcd_panel_io_callbacks_t cbs = {
+            .on_color_trans_done = on_color_trans_done,
+        };
+        esp_err_t ret = esp_lcd_panel_io_register_event_callbacks(panel.io(), &cbs, this);
+        if (ret != ESP_OK) {
+            vSemaphoreDelete(free_bufs_);
+            free_bufs_ = nullptr;
+            panel_ = nullptr;
+        }
+        ESP_RETURN_ON_ERROR(ret, "st77912_cpp", "register IO callback failed");
+        return ESP_OK;
+    }
+
+    /**
+     * Wait up to timeout for the next buffer to come back from the bus. The frame is empty on timeout.
+     */
+    Frame acquire(TickType_t timeout = portMAX_DELAY)
+    {
+        assert(!checked_out_ && "one frame at a time");
+        if (xSemaphoreTake(free_bufs_, timeout) != pdTRUE) {
+            return Frame();
+        }
+        checked_out_ = true;
+        return Frame(this, bufs_[next_].data());
+    }
+
+    /**
+     * Send the frame as a width x lines window at (x_start, y_start), its pixels packed width per line.
+     * The buffer returns to the pool once the transfer is done.
+     */
+    esp_err_t submit(Frame &&frame, int x_start, int y_start, int width = PanelT::h_res, int lines = Lines)
+    {
+        ESP_RETURN_ON_FALSE(frame.pool_ == this && width > 0 && width <= PanelT::h_res && lines > 0 && lines <= Lines,
+                            ESP_ERR_INVALID_ARG, "st77912_cpp", "invalid argument");
+        // counted before the transfer is queued, it may complete before draw() returns
+        portENTER_CRITICAL(&lock_);
+        in_flight_++;
+        portEXIT_CRITICAL(&lock_);
+        esp_err_t ret = panel_->draw(x_start, y_start, x_start + width, y_start + lines, frame.pixels_);
+        if (ret != ESP_OK) {
+            // nothing was queued, hand the buffer back unsent
+            portENTER_CRITICAL(&lock_);
+            in_flight_--;
+            portEXIT_CRITICAL(&lock_);
+            return ret;
+        }
+        // the buffer now belongs to the transfer, the callback returns it
+        frame.pool_ = nullptr;
+        frame.pixels_ = nullptr;
+        checked_out_ = false;
+        next_ = (next_ + 1) % NumBufs;
+        return ESP_OK;
+    }
+
+private:
+    static bool IRAM_ATTR on_color_trans_done(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
+    {
+        FramePool *pool = static_cast<FramePool *>(user_ctx);
+        BaseType_t need_yield = pdFALSE;
+        // other draws on the same IO complete here too, only the pool's bands free a buffer
+        portENTER_CRITICAL_ISR(&pool->lock_);
+        bool ours = pool->in_flight_ > 0;
+        if (ours) {
+            pool->in_flight_--;
+        }
+        portEXIT_CRITICAL_ISR(&pool->lock_);
+        if (ours) {
+            xSemaphoreGiveFromISR(pool->free_bufs_, &need_yield);
+        }
+        return need_yield == pdTRUE;
+    }
+
+    void unacquire()
+    {
+        // same buffer comes out again on the next acquire
+        checked_out_ = false;
+        xSemaphoreGive(free_bufs_);
+    }
+
+    const PanelT *panel_ = nullptr;
+    DmaBuffer<pixel_t> bufs_[NumBufs];
+    SemaphoreHandle_t free_bufs_ = nullptr;
+    int in_flight_ = 0;
+    portMUX_TYPE lock_ = portMUX_INITIALIZER_UNLOCKED;
+    int next_ = 0;
+    bool checked_out_ = false;
+};
+
+} // namespace esp_lcd_st77912
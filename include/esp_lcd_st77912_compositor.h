@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_lcd_panel_io.h"
+#include "esp_lcd_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Layered RGB565 compositor. Layers are blended only inside each outgoing band, just before it is handed to
+ * esp_lcd_panel_draw_bitmap(), so no full frame is ever held in RAM: memory use is 2 * h_res * band_lines * 2 bytes.
+ * Only the areas whose layer stack changed since the last flush are sent again.
+ *
+ * Not thread safe, all calls must come from the task that owns the panel.
+ */
+typedef struct st77912_compositor_t *st77912_compositor_handle_t;
+
+typedef struct {
+    int x;                      // position on the panel, may be partly off screen
+    int y;
+    int width;
+    int height;
+    const uint16_t *pixels;     // width * height RGB565 pixels, owned by the caller and read at flush time
+    uint8_t alpha;              // 255 opaque, 0 hidden
+    uint16_t color_key;         // pixels equal to this are transparent when use_color_key is set
+    struct {
+        unsigned int visible: 1;
+        unsigned int use_color_key: 1;
+    } flags;
+} st77912_layer_config_t;
+
+typedef struct {
+    esp_lcd_panel_handle_t panel;
+    esp_lcd_panel_io_handle_t io;   // its on_color_trans_done callback is taken over to recycle band buffers, and cleared by del
+    int h_res;
+    int v_res;
+    int band_lines;                 // lines per transmit band
+    uint8_t max_layers;             // layer 0 is the background, higher layers are drawn on top
+    uint16_t bg_color;              // shown where no opaque layer covers the panel
+    struct {
+        unsigned int swap_bytes: 1; // pixels are stored byte-swapped, in the order they go out on the bus
+    } flags;
+} st77912_compositor_config_t;
+
+typedef struct {
+    uint32_t flushes;
+    uint32_t bands;
+    uint64_t composed_pixels;
+    uint64_t sent_bytes;
+    uint64_t compose_us;            // time spent blending, excluding waits for the bus
+} st77912_compositor_stats_t;
+
+esp_err_t esp_lcd_st77912_compositor_new(const st77912_compositor_config_t *config, st77912_compositor_handle_t *ret_comp);
+
+/**
+ * Wait for the bands still in flight, then remove the IO callback and free the compositor.
+ */
+esp_err_t esp_lcd_st77912_compositor_del(st77912_compositor_handle_t comp);
+
+/**
+ * Add a layer on top of the existing ones, its area is marked dirty.
+ */
+esp_err_t esp_lcd_st77912_compositor_add_layer(st77912_compositor_handle_t comp, const st77912_layer_config_t *layer_config, int *ret_layer);
+
+/**
+ * Move, resize, show/hide or change alpha/color key/pixels of a layer. Old and new areas are marked dirty.
+ */
+esp_err_t esp_lcd_st77912_compositor_set_layer(st77912_compositor_handle_t comp, int layer, const st77912_layer_config_t *layer_config);
+
+/**
+ * Mark part of a layer dirty after its pixels changed in place, coordinates are relative to the layer (end exclusive).
+ */
+esp_err_t esp_lcd_st77912_compositor_invalidate(st77912_compositor_handle_t comp, int layer, int x_start, int y_start, int x_end, int y_end);
+
+/**
+ * Compose and send every dirty area band by band. Returns once the last band is queued.
+ */
+esp_err_t esp_lcd_st77912_compositor_flush(st77912_compositor_handle_t comp);
+
+esp_err_t esp_lcd_st77912_compositor_get_stats(st77912_compositor_handle_t comp, st77912_compositor_stats_t *ret_stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_lcd_types.h"
+#include "esp_lcd_st77912.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Content-adaptive frame-rate governor. It watches the draw_bitmap traffic of one panel and moves between
+ * frame-rate modes: up as soon as the screen changes fast enough, down only after it stayed quiet for hold_ms.
+ * A mode switch writes the mode's frame-rate registers and changes the rate esp_lcd_st77912_governor_wait_frame()
+ * paces the application to.
+ *
+ * Register writes only happen inside esp_lcd_st77912_governor_update()/wait_frame(), call them from the task
+ * that draws so they never interleave with a window transfer.
+ */
+#define ST77912_GOVERNOR_MAX_MODES  (4)
+
+typedef struct st77912_governor_t *st77912_governor_handle_t;
+
+typedef struct {
+    uint32_t host_fps;                      // rate the application renders at in this mode
+    uint32_t panel_hz;                      // refresh rate cmds select, only used for the power estimate
+    const st77912_lcd_init_cmd_t *cmds;     // frame-rate register writes, NULL leaves the panel refresh alone
+    uint16_t cmds_size;
+    uint16_t enter_percent;                 // screen area redrawn per second (can exceed 100) to step up into this mode
+    uint16_t exit_percent;                  // staying below this for hold_ms steps down to the mode before
+} st77912_governor_mode_t;
+
+typedef struct {
+    uint32_t mode;                          // current mode
+    uint32_t mode_switches;
+    uint32_t activity_percent;              // screen area redrawn per second over the last window
+    uint32_t bus_percent;                   // time the bus spent on pixel data over the last window
+    uint32_t power_uw;                      // estimated panel power over the last window
+    uint32_t avg_power_uw;                  // estimated since the governor was created
+    uint64_t time_in_mode_ms[ST77912_GOVERNOR_MAX_MODES];
+} st77912_governor_stats_t;
+
+/**
+ * Called from update()/wait_frame() after the registers of the new mode were written.
+ */
+typedef void (*st77912_governor_mode_cb_t)(st77912_governor_handle_t gov, uint32_t old_mode, uint32_t new_mode,
+                                           const st77912_governor_mode_t *mode, void *user_ctx);
+
+typedef struct {
+    esp_lcd_panel_handle_t panel;           // must have no hooks set, the governor installs its own
+    int h_res;
+    int v_res;
+    const st77912_governor_mode_t *modes;   // slowest first, modes[0] is used on static screens
+    uint8_t num_modes;
+    uint8_t initial_mode;
+    uint32_t window_ms;                     // activity is evaluated over windows this long
+    uint32_t hold_ms;                       // quiet time before stepping down a mode
+    uint32_t pclk_hz;                       // bus clock and data lines (1 SPI, 4 QSPI), for the bus utilization
+    uint8_t data_lines;
+    struct {
+        uint32_t static_uw;                 // panel drive independent of refresh rate
+        uint32_t uw_per_hz;                 // added per Hz of panel refresh
+        uint32_t bus_active_uw;             // added while pixel data is on the bus
+    } power;
+    st77912_governor_mode_cb_t on_mode_change;
+    void *user_ctx;
+} st77912_governor_config_t;
+
+#define ST77912_GOVERNOR_CONFIG(panel_handle, width, height, mode_table, mode_num, clock_hz, lines)  \
+    {                                                           \
+        .panel = panel_handle,                                  \
+        .h_res = width,                                         \
+        .v_res = height,                                        \
+        .modes = mode_table,                                    \
+        .num_modes = mode_num,                                  \
+        .window_ms = 250,                                       \
+        .hold_ms = 2000,                                        \
+        .pclk_hz = clock_hz,                                    \
+        .data_lines = lines,                                    \
+    }
+
+/**
+ * Fails with ESP_ERR_INVALID_STATE if the panel already has hooks set, e.g. by another governor.
+ */
+esp_err_t esp_lcd_st77912_governor_new(const st77912_governor_config_t *config, st77912_governor_handle_t *ret_gov);
+
+esp_err_t esp_lcd_st77912_governor_del(st77912_governor_handle_t gov);
+
+/**
+ * Evaluate the activity once a window has passed and apply a pending mode switch.
+ * For applications that pace themselves, e.g. by retuning their refresh timer in on_mode_change.
+ */
+esp_err_t esp_lcd_st77912_governor_update(st77912_governor_handle_t gov);
+
+/**
+ * update(), then block until the next frame slot at the current mode's host_fps. Meant to be called once per
+ * iteration of the render loop, from a single task.
+ */
+esp_err_t esp_lcd_st77912_governor_wait_frame(st77912_governor_handle_t gov);
+
+esp_err_t esp_lcd_st77912_governor_get_stats(st77912_governor_handle_t gov, st77912_governor_stats_t *ret_stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Baseline JPEG decoder that hands out one MCU row (8 or 16 lines) of RGB565 at a time, so frames can be
+ * streamed straight into transmit buffers. Supports 8-bit sequential Huffman JPEG, grayscale or YCbCr with
+ * 4:4:4, 4:2:2 and 4:2:0 sampling, and restart intervals. Only depends on esp_err.h so it builds on the host.
+ */
+#define ST77912_JPEG_FAST_BITS      (9)
+#define ST77912_JPEG_MAX_COMPS      (3)
+#define ST77912_JPEG_MAX_TABLES     (2)
+#define ST77912_JPEG_MAX_MCU_LINES  (16)
+
+typedef struct {
+    uint16_t fast[1 << ST77912_JPEG_FAST_BITS];     // (code length << 8) | symbol, 0 if the code is longer
+    int32_t maxcode[17];
+    int32_t mincode[17];
+    uint8_t valptr[17];
+    uint8_t values[256];
+} st77912_jpeg_huff_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+    uint32_t bit_buf;
+    int bit_cnt;
+    bool marker_hit;
+
+    int width;
+    int height;
+    int mcu_w;
+    int mcu_h;
+    int mcus_x;
+    int mcus_y;
+    int mcu_row;
+    int num_comps;
+    struct {
+        uint8_t id;
+        uint8_t h;
+        uint8_t v;
+        uint8_t tq;
+        uint8_t td;
+        uint8_t ta;
+        int dc_pred;
+    } comps[ST77912_JPEG_MAX_COMPS];
+    uint16_t restart_interval;
+    uint16_t mcus_to_restart;
+    // everything from here on is kept between images, Motion-JPEG frames often reuse earlier tables
+    uint16_t qt[4][64];
+    uint8_t huff_defined;
+    st77912_jpeg_huff_t dc_huff[ST77912_JPEG_MAX_TABLES];
+    st77912_jpeg_huff_t ac_huff[ST77912_JPEG_MAX_TABLES];
+    uint8_t planes[ST77912_JPEG_MAX_COMPS][ST77912_JPEG_MAX_MCU_LINES * ST77912_JPEG_MAX_MCU_LINES];
+} st77912_jpeg_dec_t;
+
+/**
+ * Parse the headers of one JPEG image up to the start of its entropy-coded data. The decoder must be zeroed
+ * before its first image. Tables are kept across calls, missing Huffman tables fall back to the standard ones.
+ * Returns ESP_ERR_NOT_SUPPORTED for progressive/12-bit/16-bit tables/unusual sampling, ESP_ERR_INVALID_RESPONSE for
+ * malformed data.
+ */
+esp_err_t esp_lcd_st77912_jpeg_start(st77912_jpeg_dec_t *dec, const uint8_t *data, size_t len);
+
+/**
+ * Decode the next MCU row into out (dec->width pixels per line, out_stride pixels apart, dec->mcu_h lines).
+ * *ret_lines is the number of image lines written, 0 once the whole image has been decoded.
+ * swap_bytes stores every pixel byte-swapped, in the order it goes out on the SPI bus.
+ */
+esp_err_t esp_lcd_st77912_jpeg_decode_rows(st77912_jpeg_dec_t *dec, uint16_t *out, int out_stride, bool swap_bytes, int *ret_lines);
+
+/**
+ * Find the next complete JPEG (SOI..EOI) in a Motion-JPEG stream of concatenated images, starting at *offset.
+ * *offset is advanced past the frame. Returns ESP_ERR_NOT_FOUND at the end of the stream, ESP_ERR_INVALID_RESPONSE
+ * for a broken or truncated frame, with *offset moved past its SOI so the search can go on.
+ */
+esp_err_t esp_lcd_st77912_jpeg_next_frame(const uint8_t *stream, size_t len, size_t *offset, const uint8_t **ret_frame, size_t *ret_frame_len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_lcd_panel_io.h"
+#include "esp_lcd_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Motion-JPEG player. One task decodes MCU rows straight into a small ring of DMA band buffers, another hands
+ * them to esp_lcd_panel_draw_bitmap(), each pinned to its own core. Frames are paced to a target rate and skipped
+ * without decoding when playback falls a full frame behind. No full RGB565 frame is ever held in RAM.
+ */
+typedef struct st77912_mjpeg_player_t *st77912_mjpeg_handle_t;
+
+typedef struct {
+    uint32_t frame;             // index in the clip
+    bool dropped;               // skipped to catch up, the timings below are 0
+    bool corrupt;               // failed to parse or decode and was skipped, bands decoded before the error were sent
+    bool failed;                // a band could not be sent, the panel shows only part of the frame
+    uint32_t decode_us;         // time spent decoding, excluding waits for a free band buffer
+    uint32_t transmit_us;       // first band queued until the last band left the bus
+    uint32_t idle_us;           // waiting for the frame's slot
+} st77912_mjpeg_frame_stats_t;
+
+typedef struct {
+    uint32_t frames;            // frames found in the clips played so far
+    uint32_t dropped;
+    uint32_t corrupt;
+} st77912_mjpeg_stats_t;
+
+typedef void (*st77912_mjpeg_frame_cb_t)(const st77912_mjpeg_frame_stats_t *stats, void *user_ctx);
+
+typedef struct {
+    esp_lcd_panel_handle_t panel;
+    esp_lcd_panel_io_handle_t io;       // its on_color_trans_done callback is taken over to recycle band buffers, and cleared by del
+    int x;                              // top-left corner of the clip on the panel
+    int y;
+    int max_width;                      // widest frame in the clips, sizes the band buffers
+    uint32_t fps;                       // target frame rate
+    int decode_core;
+    int transmit_core;
+    UBaseType_t task_priority;
+    uint32_t task_stack;
+    st77912_mjpeg_frame_cb_t on_frame;  // called from the transmit task after every frame, shown, dropped or corrupt
+    void *user_ctx;
+    struct {
+        unsigned int swap_bytes: 1;     // send RGB565 high byte first, as the panel expects over SPI
+    } flags;
+} st77912_mjpeg_config_t;
+
+#define ST77912_MJPEG_PLAYER_CONFIG(panel_handle, io_handle, width, frame_rate)  \
+    {                                                           \
+        .panel = panel_handle,                                  \
+        .io = io_handle,                                        \
+        .max_width = width,                                     \
+        .fps = frame_rate,                                      \
+        .decode_core = 1,                                       \
+        .transmit_core = 0,                                     \
+        .task_priority = 5,                                     \
+        .task_stack = 4096,                                     \
+        .flags = {                                              \
+            .swap_bytes = true,                                 \
+        },                                                      \
+    }
+
+esp_err_t esp_lcd_st77912_mjpeg_new(const st77912_mjpeg_config_t *config, st77912_mjpeg_handle_t *ret_player);
+
+/**
+ * Play a clip of concatenated JPEG frames, blocks until the last frame has been sent.
+ * Corrupt frames are skipped and counted, playback goes on with the next one.
+ * The clip must stay valid until the call returns.
+ */
+esp_err_t esp_lcd_st77912_mjpeg_play(st77912_mjpeg_handle_t player, const uint8_t *clip, size_t len);
+
+esp_err_t esp_lcd_st77912_mjpeg_get_stats(st77912_mjpeg_handle_t player, st77912_mjpeg_stats_t *ret_stats);
+
+/**
+ * Stop the tasks, wait for the bands still in flight, then remove the IO callback and free the player.
+ */
+esp_err_t esp_lcd_st77912_mjpeg_del(st77912_mjpeg_handle_t player);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,322 @@
+#!/usr/bin/env python3
+"""
+Analyze draw-call traces recorded by esp_lcd_st77912_trace_dump(), and replay them through a host build of the
+driver against the mock panel IO.
+
+Feed it a serial log (anything not starting with ST77912TRACE is ignored):
+
+    st77912_trace.py analyze monitor.log --pclk 40
+    st77912_trace.py compare before.log after.log
+    st77912_trace.py replay monitor.log --driver build/st77912_replay [--check]
+
+Bus time comes from a model that charges every transaction a fixed setup overhead plus its bits at pclk: on SPI
+everything goes out on one line, on QSPI the 32-bit command phase and parameters use one line and pixel data
+uses four. Transactions are serialized on the bus, so utilization is busy time over the span until the last
+one completes and never exceeds 100%.
+
+replay feeds the recorded API calls (draws, gaps, mirror/swap/invert/display, send_cmds, health checks) to
+st77912_replay, built from host_test against the driver sources under test. It records what that driver sends
+to the mock IO and compares it with the recorded traffic; --check fails on the first difference.
+"""
+
+import argparse
+import re
+import struct
+import subprocess
+import sys
+from collections import Counter, defaultdict
+
+REC_FMT = '<IBBH8s'
+REC_SIZE = struct.calcsize(REC_FMT)
+
+PARAM, COLOR, READ, DRAW, RESET, INIT, GAP, CALL = range(1, 9)
+BUS_TYPES = (PARAM, COLOR, READ)
+
+CMD_SWRESET = 0x01
+CMD_SLPOUT = 0x11
+CMD_INVOFF = 0x20
+CMD_INVON = 0x21
+CMD_DISPOFF = 0x28
+CMD_DISPON = 0x29
+CMD_CASET = 0x2A
+CMD_RASET = 0x2B
+CMD_MADCTL = 0x36
+CMD_BANK = 0xF0
+
+CMD_NAMES = {
+    CMD_SWRESET: 'SWRESET', CMD_SLPOUT: 'SLPOUT', CMD_INVOFF: 'INVOFF', CMD_INVON: 'INVON',
+    CMD_DISPOFF: 'DISPOFF', CMD_DISPON: 'DISPON', CMD_CASET: 'CASET', CMD_RASET: 'RASET',
+    0x2C: 'RAMWR', 0x3C: 'RAMWRC', CMD_MADCTL: 'MADCTL', 0x3A: 'COLMOD', 0x09: 'RDDST', 0x04: 'RDDID',
+}
+
+# commands whose zero-parameter form toggles a state, sending the current state again is redundant
+STATE_PAIRS = {CMD_INVON: 'inv', CMD_INVOFF: 'inv', CMD_DISPON: 'disp', CMD_DISPOFF: 'disp'}
+
+
+class Trace:
+    def __init__(self, path, lines=None):
+        self.bpp = 16
+        self.qspi = False
+        self.dropped = 0
+        self.version = 1
+        self.recs = []
+        pattern = re.compile(r'ST77912TRACE (v\d+ .*|[0-9a-f]{%d})\s*$' % (REC_SIZE * 2))
+        if lines is None:
+            with open(path, errors='replace') as f:
+                lines = f.readlines()
+        for line in lines:
+            m = pattern.search(line)
+            if not m:
+                continue
+            body = m.group(1)
+            if body.startswith('v'):
+                # a new dump restarts the trace, keep the last one in the log
+                fields = dict(kv.split('=') for kv in body.split()[1:])
+                self.version = int(body.split()[0][1:])
+                self.bpp = int(fields.get('bpp', 16))
+                self.qspi = fields.get('qspi', '0') == '1'
+                self.dropped = int(fields.get('dropped', 0))
+                self.recs = []
+                continue
+            ts, typ, cmd, length, data = struct.unpack(REC_FMT, bytes.fromhex(body))
+            self.recs.append((ts, typ, cmd, length, data))
+        if not self.recs:
+            raise SystemExit('%s: no ST77912TRACE records found' % path)
+        # timestamps are the low 32 bits of esp_timer, unwrap them
+        base = 0
+        prev = self.recs[0][0]
+        unwrapped = []
+        for ts, *rest in self.recs:
+            if ts < prev:
+                base += 1 << 32
+            prev = ts
+            unwrapped.append((ts + base, *rest))
+        self.recs = unwrapped
+
+
+class BusModel:
+    def __init__(self, pclk_hz, overhead_us, qspi):
+        self.pclk_hz = pclk_hz
+        self.overhead_us = overhead_us
+        self.qspi = qspi
+
+    def cmd_us(self, param_bytes):
+        cmd_bits = 32 if self.qspi else 8
+        return self.overhead_us + (cmd_bits + param_bytes * 8) * 1e6 / self.pclk_hz
+
+    def color_us(self, color_bytes):
+        cmd_bits = 32 if self.qspi else 8
+        lines = 4 if self.qspi else 1
+        return self.overhead_us + (cmd_bits + color_bytes * 8 / lines) * 1e6 / self.pclk_hz
+
+
+def analyze(trace, args):
+    bus = BusModel(args.pclk * 1e6, args.overhead_us, trace.qspi if args.qspi is None else args.qspi)
+    res = {
+        'records': len(trace.recs),
+        'dropped': trace.dropped,
+        'span_us': 0,
+        'types': Counter(),
+        'cmds': Counter(),
+        'bus_us': 0.0,
+        'cmd_bus_us': 0.0,
+        'color_bus_us': 0.0,
+        'color_bytes': 0,
+        'draws': 0,
+        'small_draws': 0,
+        'redundant': Counter(),
+        'redundant_us': 0.0,
+        'frames': 0,
+        'pixels_written': 0,
+        'pixels_unique': 0,
+    }
+
+    last_param = {}
+    state = {}
+    bank = 0
+    frame = None
+    frame_end_us = None
+    bus_free_us = trace.recs[0][0]
+
+    def occupy(ts, t):
+        # a transfer starts once it is issued and the previous one has left the bus
+        nonlocal bus_free_us
+        bus_free_us = max(bus_free_us, ts) + t
+        res['bus_us'] += t
+
+    def close_frame():
+        if frame is None:
+            return
+        res['frames'] += 1
+        res['pixels_written'] += frame['written']
+        res['pixels_unique'] += sum(bin(mask).count('1') for mask in frame['rows'].values())
+
+    for ts, typ, cmd, length, data in trace.recs:
+        res['types'][typ] += 1
+        if typ in (RESET, INIT):
+            # the controller forgets everything, nothing sent afterwards repeats earlier state
+            last_param.clear()
+            state.clear()
+            bank = 0
+        elif typ == PARAM:
+            res['cmds'][cmd] += 1
+            t = bus.cmd_us(length)
+            occupy(ts, t)
+            res['cmd_bus_us'] += t
+            params = data[:length] if length <= len(data) else None
+            key = (bank, cmd)
+            redundant = False
+            if cmd in STATE_PAIRS and length == 0:
+                redundant = state.get(STATE_PAIRS[cmd]) == cmd
+                state[STATE_PAIRS[cmd]] = cmd
+            elif length and params is not None:
+                redundant = last_param.get(key) == params
+                last_param[key] = params
+            elif length:
+                # parameters were truncated in the record, can't tell
+                last_param.pop(key, None)
+            if redundant and cmd not in (CMD_BANK,):
+                res['redundant'][cmd] += 1
+                res['redundant_us'] += t
+            if cmd == CMD_BANK and length:
+                bank = data[0]
+        elif typ == COLOR:
+            n = struct.unpack_from('<I', data)[0]
+            res['cmds'][cmd] += 1
+            t = bus.color_us(n)
+            occupy(ts, t)
+            res['color_bus_us'] += t
+            res['color_bytes'] += n
+        elif typ == READ:
+            res['cmds'][cmd] += 1
+            occupy(ts, bus.cmd_us(length))
+        elif typ == DRAW:
+            x0, y0, x1, y1 = struct.unpack_from('<4h', data)
+            res['draws'] += 1
+            area = max(0, x1 - x0) * max(0, y1 - y0)
+            if area < args.small_draw:
+                res['small_draws'] += 1
+            # draws closer together than frame_gap belong to the same frame
+            if frame is None or ts - frame_end_us > args.frame_gap_ms * 1000:
+                close_frame()
+                frame = {'written': 0, 'rows': defaultdict(int)}
+            frame_end_us = ts
+            frame['written'] += area
+            if area:
+                # one bit per covered column, per row
+                span = ((1 << (x1 - x0)) - 1) << max(x0, 0)
+                for y in range(y0, y1):
+                    frame['rows'][y] |= span
+    close_frame()
+    res['span_us'] = max(trace.recs[-1][0], bus_free_us) - trace.recs[0][0]
+    return res
+
+
+def fmt_cmd(cmd):
+    return '%02Xh %s' % (cmd, CMD_NAMES.get(cmd, ''))
+
+
+def report(path, res, args):
+    span = res['span_us'] or 1
+    print('== %s' % path)
+    print('records          %d (%d overwritten before the dump)' % (res['records'], res['dropped']))
+    print('span             %.1f ms (until the last transfer completes)' % (res['span_us'] / 1000))
+    print('bus time         %.1f ms (%.1f%% utilization), commands %.1f ms, pixels %.1f ms' % (
+        res['bus_us'] / 1000, 100 * res['bus_us'] / span, res['cmd_bus_us'] / 1000, res['color_bus_us'] / 1000))
+    print('pixel data       %.1f KB' % (res['color_bytes'] / 1024))
+    print('draw_bitmap      %d calls, %d below %d px' % (res['draws'], res['small_draws'], args.small_draw))
+    if res['pixels_unique']:
+        print('overdraw         %d frames, %.2fx (%d px written for %d px covered)' % (
+            res['frames'], res['pixels_written'] / res['pixels_unique'], res['pixels_written'], res['pixels_unique']))
+    redundant = sum(res['redundant'].values())
+    print('redundant cmds   %d (%.2f ms of bus time)' % (redundant, res['redundant_us'] / 1000))
+    for cmd, n in res['redundant'].most_common(8):
+        print('    %-14s %d' % (fmt_cmd(cmd), n))
+    print('commands')
+    for cmd, n in res['cmds'].most_common(12):
+        print('    %-14s %d' % (fmt_cmd(cmd), n))
+
+
+def compare(a_path, a, b_path, b):
+    rows = [
+        ('bus time ms', a['bus_us'] / 1000, b['bus_us'] / 1000),
+        ('command bus time ms', a['cmd_bus_us'] / 1000, b['cmd_bus_us'] / 1000),
+        ('pixel bus time ms', a['color_bus_us'] / 1000, b['color_bus_us'] / 1000),
+        ('pixel KB', a['color_bytes'] / 1024, b['color_bytes'] / 1024),
+        ('draw_bitmap calls', a['draws'], b['draws']),
+        ('commands', sum(a['cmds'].values()), sum(b['cmds'].values())),
+        ('redundant commands', sum(a['redundant'].values()), sum(b['redundant'].values())),
+        ('overdraw x', a['pixels_written'] / max(a['pixels_unique'], 1), b['pixels_written'] / max(b['pixels_unique'], 1)),
+    ]
+    print('%-22s %14s %14s %9s' % ('', 'A', 'B', 'B/A'))
+    for name, va, vb in rows:
+        ratio = '%8.2fx' % (vb / va) if va else '%9s' % '-'
+        print('%-22s %14.2f %14.2f %s' % (name, va, vb, ratio))
+    print('A: %s\nB: %s' % (a_path, b_path))
+
+
+def bus_traffic(trace):
+    return [(typ, cmd, length, data) for _, typ, cmd, length, data in trace.recs if typ in BUS_TYPES]
+
+
+def replay(args):
+    recorded = Trace(args.log)
+    if recorded.version < 2:
+        print('warning: %s is a v1 dump without API call records, state changes and send_cmds are not replayed'
+              % args.log, file=sys.stderr)
+    out = subprocess.run([args.driver, args.log, str(int(args.pclk * 1e6))], stdout=subprocess.PIPE,
+                         universal_newlines=True)
+    if out.returncode:
+        raise SystemExit('%s failed (%d), see its log above' % (args.driver, out.returncode))
+    replayed = Trace('%s (replayed)' % args.log, out.stdout.splitlines())
+    compare(args.log, analyze(recorded, args), 'replayed by ' + args.driver, analyze(replayed, args))
+    if not args.check:
+        return 0
+
+    a = bus_traffic(recorded)
+    b = bus_traffic(replayed)
+    for i, (ra, rb) in enumerate(zip(a, b)):
+        if ra != rb:
+            print('traffic differs at bus transfer %d: recorded %s, replayed %s' % (i, fmt_rec(ra), fmt_rec(rb)))
+            return 1
+    if len(a) != len(b):
+        print('traffic differs: %d transfers recorded, %d replayed' % (len(a), len(b)))
+        return 1
+    print('bus traffic identical (%d transfers)' % len(a))
+    return 0
+
+
+def fmt_rec(rec):
+    typ, cmd, length, data = rec
+    names = {PARAM: 'param', COLOR: 'color', READ: 'read'}
+    if typ == COLOR:
+        return '%s %s %d bytes' % (names[typ], fmt_cmd(cmd), struct.unpack_from('<I', data)[0])
+    return '%s %s len %d [%s]' % (names[typ], fmt_cmd(cmd), length, data[:min(length, len(data))].hex())
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--pclk', type=float, default=40, help='bus clock in MHz (default 40)')
+    parser.add_argument('--overhead-us', type=float, default=2.0, help='setup cost per transaction (default 2 us)')
+    parser.add_argument('--qspi', type=lambda v: v == '1', default=None, help='override the interface in the trace (0/1)')
+    parser.add_argument('--frame-gap-ms', type=float, default=5, help='idle time that separates frames (default 5 ms)')
+    parser.add_argument('--small-draw', type=int, default=64, help='pixel count below which a draw is reported as small')
+    sub = parser.add_subparsers(dest='command', required=True)
+    p = sub.add_parser('analyze', help='report bus time, redundant commands and overdraw')
+    p.add_argument('log')
+    p = sub.add_parser('compare', help='compare two traces, e.g. the same workload on two driver versions')
+    p.add_argument('log_a')
+    p.add_argument('log_b')
+    p = sub.add_parser('replay', help='run the recorded calls through a host build of the driver and compare')
+    p.add_argument('log')
+    p.add_argument('--driver', required=True, help='st77912_replay built from host_test')
+    p.add_argument('--check', action='store_true', help='exit with 1 unless the bus traffic is identical')
+    args = parser.parse_args()
+
+    if args.command == 'analyze':
+        report(args.log, analyze(Trace(args.log), args), args)
+    elif args.command == 'compare':
+        compare(args.log_a, analyze(Trace(args.log_a), args), args.log_b, analyze(Trace(args.log_b), args))
+    else:
+        sys.exit(replay(args))
+    sys.exit(0)